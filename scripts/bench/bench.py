@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Compile-throughput benchmark of tiger-compiler.
+
+Each preset generates a program with gen_tiger.py, compiles it with
+-ftime-report and records wall time, lines/sec, peak RSS and the time of
+every compiler phase. Results can be saved as a baseline and later runs
+compared against it:
+
+  python3 scripts/bench/bench.py --save bench-baseline.json
+  python3 scripts/bench/bench.py --baseline bench-baseline.json
+
+With --baseline the script exits with status 1 if the total time of any
+preset grows by more than --threshold.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(os.path.dirname(HERE))
+
+# name -> gen_tiger.py arguments. Each stresses one dimension of the back end.
+PRESETS = [
+    ("small", ["--functions", "10"]),
+    ("many_functions", ["--functions", "200"]),
+    ("deep_nesting", ["--functions", "20", "--nesting", "16"]),
+    ("long_blocks", ["--functions", "4", "--block", "1000"]),
+    ("high_pressure", ["--functions", "4", "--pressure", "32",
+                       "--block", "50"]),
+    ("records_strings", ["--functions", "50", "--records", "16",
+                         "--fields", "8", "--strings", "8"]),
+    ("mixed", ["--functions", "40", "--nesting", "3", "--block", "40",
+               "--pressure", "12", "--records", "4", "--strings", "2"]),
+]
+
+
+def generate(name, gen_args, workdir):
+    path = os.path.join(workdir, name + ".tig")
+    subprocess.check_call([sys.executable, os.path.join(HERE, "gen_tiger.py")]
+                          + gen_args + ["-o", path])
+    with open(path) as f:
+        lines = sum(1 for _ in f)
+    return path, lines
+
+
+def compile_once(compiler, path, jobs):
+    report = path + ".time.json"
+    cmd = [compiler, "-ftime-report=" + report]
+    if jobs > 1:
+        cmd += ["-j", str(jobs)]
+    cmd.append(path)
+    start = time.perf_counter()
+    proc = subprocess.run(cmd, stdout=subprocess.DEVNULL,
+                          stderr=subprocess.PIPE, universal_newlines=True)
+    wall_ms = (time.perf_counter() - start) * 1000
+    if proc.returncode != 0:
+        sys.exit("bench.py: %s failed:\n%s" % (" ".join(cmd), proc.stderr))
+    with open(report) as f:
+        data = json.load(f)
+    return wall_ms, data
+
+
+def run_preset(args, name, gen_args):
+    path, lines = generate(name, gen_args, args.workdir)
+    best = None
+    for _ in range(args.repeat):
+        wall_ms, data = compile_once(args.compiler, path, args.jobs)
+        if best is None or wall_ms < best[0]:
+            best = (wall_ms, data)
+    wall_ms, data = best
+    return {
+        "args": gen_args,
+        "lines": lines,
+        "wall_ms": round(wall_ms, 3),
+        "lines_per_sec": round(lines * 1000 / wall_ms, 1),
+        "peak_rss_kb": data["peak_rss_kb"],
+        "phases": {p["phase"]: p["ms"] for p in data["phases"]},
+    }
+
+
+def print_table(results, phases):
+    head = "%-16s %7s %10s %10s %9s" % ("preset", "lines", "wall(ms)",
+                                        "lines/s", "rss(kB)")
+    print(head + "".join(" %10s" % p for p in phases))
+    for name, r in results.items():
+        row = "%-16s %7d %10.1f %10.1f %9d" % (
+            name, r["lines"], r["wall_ms"], r["lines_per_sec"],
+            r["peak_rss_kb"])
+        print(row + "".join(" %10.1f" % r["phases"].get(p, 0) for p in phases))
+
+
+def compare(results, baseline, threshold):
+    """Print the ratio to the baseline, return the names that regressed."""
+    regressed = []
+    print("\n%-16s %10s %10s %7s %9s" % ("preset", "base(ms)", "now(ms)",
+                                          "ratio", "rss ratio"))
+    for name, r in results.items():
+        base = baseline.get(name)
+        if base is None or base["args"] != r["args"]:
+            print("%-16s  (no comparable baseline)" % name)
+            continue
+        ratio = r["wall_ms"] / base["wall_ms"]
+        rss = r["peak_rss_kb"] / max(base["peak_rss_kb"], 1)
+        mark = ""
+        if ratio > 1 + threshold:
+            mark = "  REGRESSION"
+            regressed.append(name)
+        print("%-16s %10.1f %10.1f %7.2f %9.2f%s" % (
+            name, base["wall_ms"], r["wall_ms"], ratio, rss, mark))
+        for phase, ms in r["phases"].items():
+            base_ms = base["phases"].get(phase)
+            if base_ms and ms > base_ms * (1 + threshold) and ms - base_ms > 1:
+                print("  %-14s %10.1f %10.1f %7.2f" % (phase, base_ms, ms,
+                                                       ms / base_ms))
+    return regressed
+
+
+def parser():
+    p = argparse.ArgumentParser(
+        description="Benchmark tiger-compiler on generated programs.")
+    p.add_argument("--compiler",
+                   default=os.path.join(ROOT, "build", "tiger-compiler"))
+    p.add_argument("--workdir", default=os.path.join(ROOT, "build", "bench"))
+    p.add_argument("--preset", action="append",
+                   help="run only this preset (repeatable), one of: "
+                   + ", ".join(name for name, _ in PRESETS))
+    p.add_argument("-j", "--jobs", type=int, default=1,
+                   help="pass -j to the compiler")
+    p.add_argument("--repeat", type=int, default=3,
+                   help="compile each program this many times, keep the best")
+    p.add_argument("--save", help="write the results to this file")
+    p.add_argument("--baseline", help="compare with results saved by --save")
+    p.add_argument("--threshold", type=float, default=0.10,
+                   help="allowed slowdown against the baseline (0.10 = 10%%)")
+    return p
+
+
+def main():
+    args = parser().parse_args()
+    if not os.access(args.compiler, os.X_OK):
+        sys.exit("bench.py: no compiler at %s, run `make build` first"
+                 % args.compiler)
+    os.makedirs(args.workdir, exist_ok=True)
+    presets = [(n, a) for n, a in PRESETS
+               if not args.preset or n in args.preset]
+    if args.preset and len(presets) != len(args.preset):
+        sys.exit("bench.py: unknown preset in %s" % args.preset)
+
+    results = {}
+    phases = []
+    for name, gen_args in presets:
+        results[name] = run_preset(args, name, gen_args)
+        for phase in results[name]["phases"]:
+            if phase not in phases:
+                phases.append(phase)
+    print_table(results, phases)
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+            f.write("\n")
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        if compare(results, baseline, args.threshold):
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
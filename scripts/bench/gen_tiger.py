@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Generate a synthetic Tiger program of tunable size.
+
+The program is valid Tiger that compiles and runs with this compiler. It
+prints one integer, so runs at different -j levels can be compared.
+
+Knobs:
+  --functions N   number of top-level functions
+  --nesting D     depth of nested functions in each function (static links)
+  --block L       length of the straight-line assignment block per function
+  --pressure P    number of locals kept live until the end of each function
+  --records R     number of record types; each function allocates one record
+                  and builds a short linked list
+  --strings S     string literals per function
+"""
+
+import argparse
+import sys
+
+
+class Generator(object):
+
+    def __init__(self, args):
+        self.args = args
+        self.out = []
+
+    def emit(self, line, indent):
+        self.out.append("  " * indent + line)
+
+    def types(self):
+        a = self.args
+        self.emit("type list = {value: int, next: list}", 1)
+        for r in range(a.records):
+            fields = ", ".join("f%d: int" % k for k in range(a.fields))
+            self.emit("type rec%d = {%s}" % (r, fields), 1)
+
+    def nested(self, i, depth, indent):
+        # f<i>_g1 calls f<i>_g2 ..., every level reads the locals of f<i>.
+        # Function names become assembly labels, so they must be unique.
+        name = "f%d_g%d" % (i, depth)
+        inner = "x + a + v%d" % (depth % self.args.pressure)
+        if depth == self.args.nesting:
+            self.emit("function %s(x: int): int = %s" % (name, inner), indent)
+            return
+        self.emit("function %s(x: int): int =" % name, indent)
+        self.emit("let", indent + 1)
+        self.nested(i, depth + 1, indent + 2)
+        self.emit("in f%d_g%d(x + 1) + v0 end" % (i, depth + 1), indent + 1)
+
+    def function(self, i):
+        a = self.args
+        p = a.pressure
+        self.emit("function f%d(a: int, b: int): int =" % i, 1)
+        self.emit("let", 2)
+        self.emit("var v0 := a + b", 3)
+        for j in range(1, p):
+            self.emit("var v%d := v%d + a * %d" % (j, j - 1, j % 7 + 1), 3)
+        if a.records:
+            r = i % a.records
+            inits = ", ".join("f%d = v%d + %d" % (k, k % p, k)
+                              for k in range(a.fields))
+            self.emit("var r := rec%d {%s}" % (r, inits), 3)
+            # "var l : list := nil" is typed as nil by semant, start non-empty
+            self.emit("var l := list {value = b, next = nil}", 3)
+            self.emit("var t := 0", 3)
+        for s in range(a.strings):
+            self.emit('var s%d := "f%dstring%dliteral"' % (s, i, s), 3)
+        if a.nesting:
+            self.nested(i, 1, 3)
+        self.emit("in", 2)
+        self.emit("(", 3)
+        for j in range(a.block):
+            d, x, y = j % p, (j + 1) % p, (j + 2) % p
+            self.emit("v%d := v%d + v%d * %d;" % (d, x, y, j % 5 + 1), 4)
+        if a.records:
+            self.emit("for k := 0 to 3 do l := list {value = k + r.f0, "
+                      "next = l};", 4)
+            self.emit("while l <> nil do (t := t + l.value; l := l.next);",
+                      4)
+        terms = ["v%d" % j for j in range(p)]
+        if a.records:
+            terms += ["r.f%d" % k for k in range(a.fields)] + ["t"]
+        terms += ["size(concat(s%d, \"x\"))" % s for s in range(a.strings)]
+        if a.nesting:
+            terms.append("f%d_g1(a)" % i)
+        if i > 0 and i % 4 == 0:
+            terms.append("f%d(b, a)" % (i - 1))
+        self.emit(" + ".join(terms), 4)
+        self.emit(")", 3)
+        self.emit("end", 2)
+
+    def generate(self):
+        a = self.args
+        self.emit("/* generated by scripts/bench/gen_tiger.py %s */"
+                  % " ".join(sys.argv[1:]), 0)
+        self.emit("let", 0)
+        self.types()
+        self.emit("var total := 0", 1)
+        for i in range(a.functions):
+            self.function(i)
+        self.emit("in", 0)
+        self.emit("(", 1)
+        for i in range(a.functions):
+            self.emit("total := total + f%d(%d, 1);" % (i, i % 10), 2)
+        self.emit('printi(total); print("\\n")', 2)
+        self.emit(")", 1)
+        self.emit("end", 0)
+        return "\n".join(self.out) + "\n"
+
+
+def parser():
+    p = argparse.ArgumentParser(
+        description="Generate a synthetic Tiger program.")
+    p.add_argument("--functions", type=int, default=10)
+    p.add_argument("--nesting", type=int, default=0)
+    p.add_argument("--block", type=int, default=8)
+    p.add_argument("--pressure", type=int, default=4)
+    p.add_argument("--records", type=int, default=0)
+    p.add_argument("--fields", type=int, default=4)
+    p.add_argument("--strings", type=int, default=0)
+    p.add_argument("-o", "--output", help="output file (default stdout)")
+    return p
+
+
+def main():
+    args = parser().parse_args()
+    if args.pressure < 1 or args.functions < 1:
+        sys.exit("gen_tiger.py: --pressure and --functions must be >= 1")
+    text = Generator(args).generate()
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+
+
+if __name__ == "__main__":
+    main()
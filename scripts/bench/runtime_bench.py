@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Micro-benchmark of array initialisation in the runtime.
+
+For every array size class a Tiger program allocates arrays of that many
+elements in a loop, once filled with 0 and once with a non-zero value, so
+about --words elements are written in total. The program is compiled with
+tiger-compiler, linked with runtime.cc and heap.cc and run once per fill
+kernel (TIGER_FILL=scalar|sse2|avx2). The table shows nanoseconds per
+element, the best of --repeat runs:
+
+  python3 scripts/bench/runtime_bench.py
+  python3 scripts/bench/runtime_bench.py --gc generational --kernel avx2
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(os.path.dirname(HERE))
+RUNTIME = os.path.join(ROOT, "src", "tiger", "runtime")
+
+SIZES = [8, 64, 512, 4096, 32768, 262144, 2097152]
+KERNELS = ["scalar", "sse2", "avx2"]
+
+PROGRAM = """let
+  type arr = array of int
+  var a := arr[1] of 0
+  var sum := 0
+in
+  for i := 1 to %(iters)d do (a := arr[%(size)d] of %(init)d;
+                             sum := sum + a[%(size)d - 1]);
+  printi(sum)
+end
+"""
+
+
+def build(args, size, init):
+    name = "init_array_%d_%d" % (size, init)
+    iters = max(args.words // size, 1)
+    path = os.path.join(args.workdir, name + ".tig")
+    with open(path, "w") as f:
+        f.write(PROGRAM % {"iters": iters, "size": size, "init": init})
+    subprocess.check_call([args.compiler, path], cwd=args.workdir,
+                          stdout=subprocess.DEVNULL)
+    exe = os.path.join(args.workdir, name)
+    # GET_RBP in the runtime needs frame pointers at any optimisation level
+    sources = [path + ".s", os.path.join(RUNTIME, "runtime.cc"),
+               os.path.join(RUNTIME, "gc", "heap", "heap.cc")]
+    subprocess.check_call(
+        ["g++", "-w", "-fno-omit-frame-pointer", "-Wl,--wrap,getchar",
+         "-Wl,-z,noexecstack"] + args.cflags.split() + sources + ["-o", exe])
+    return exe, iters * size
+
+
+def run(args, exe, kernel):
+    env = dict(os.environ, TIGER_FILL=kernel)
+    if args.gc:
+        env["TIGER_GC"] = args.gc
+    best = None
+    for _ in range(args.repeat):
+        start = time.perf_counter()
+        subprocess.run([exe], env=env, stdout=subprocess.DEVNULL)
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def parser():
+    p = argparse.ArgumentParser(
+        description="Benchmark init_array fill kernels per size class.")
+    p.add_argument("--compiler",
+                   default=os.path.join(ROOT, "build", "tiger-compiler"))
+    p.add_argument("--workdir",
+                   default=os.path.join(ROOT, "build", "bench-runtime"))
+    p.add_argument("--cflags", default="-O2",
+                   help="flags used to compile the runtime")
+    p.add_argument("--gc", choices=["copying", "generational"],
+                   help="TIGER_GC mode, mark-sweep by default")
+    p.add_argument("--kernel", action="append", choices=KERNELS,
+                   help="run only this kernel (repeatable)")
+    p.add_argument("--size", action="append", type=int,
+                   help="run only this array size (repeatable)")
+    p.add_argument("--words", type=int, default=1 << 25,
+                   help="elements written per program")
+    p.add_argument("--repeat", type=int, default=3,
+                   help="run each program this many times, keep the best")
+    return p
+
+
+def main():
+    args = parser().parse_args()
+    if not os.access(args.compiler, os.X_OK):
+        sys.exit("runtime_bench.py: no compiler at %s, run `make build` first"
+                 % args.compiler)
+    os.makedirs(args.workdir, exist_ok=True)
+    kernels = args.kernel or KERNELS
+    sizes = args.size or SIZES
+
+    print("%-10s %5s" % ("elements", "init")
+          + "".join(" %9s" % ("%s(ns)" % k) for k in kernels))
+    for size in sizes:
+        for init in (0, 7):
+            exe, elements = build(args, size, init)
+            row = "%-10d %5d" % (size, init)
+            for kernel in kernels:
+                seconds = run(args, exe, kernel)
+                row += " %9.3f" % (seconds * 1e9 / elements)
+            print(row)
+
+
+if __name__ == "__main__":
+    main()
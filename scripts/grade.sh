@@ -302,13 +302,19 @@ test_lab7() {
     fi
 
     
-    ./test.out >&/tmp/output.txt
-    diff -w -B /tmp/output.txt "$ref"
-    if [[ $? != 0 ]]; then
-      echo "Error: Output mismatch [$testcase_name]"
-      full_score=0
-      continue
-    fi
+    # 每个GC算法各运行一次
+    local passed=1
+    for gc_mode in mark-sweep copying generational; do
+      TIGER_GC=$gc_mode ./test.out >&/tmp/output.txt
+      diff -w -B /tmp/output.txt "$ref"
+      if [[ $? != 0 ]]; then
+        echo "Error: Output mismatch [$testcase_name] (TIGER_GC=$gc_mode)"
+        full_score=0
+        passed=0
+        break
+      fi
+    done
+    [[ $passed == 0 ]] && continue
     echo "Pass $testcase_name"
     score=$((score + 5))
   done
@@ -28,12 +28,9 @@ AbsynTree::~AbsynTree() { delete root_; }
 
 void AbsynTree::Print(FILE *out) const { root_->Print(out, 0); }
 
-SimpleVar::~SimpleVar() { delete sym_; }
+SimpleVar::~SimpleVar() = default;
 
-FieldVar::~FieldVar() {
-  delete var_;
-  delete sym_;
-}
+FieldVar::~FieldVar() { delete var_; }
 
 SubscriptVar::~SubscriptVar() {
   delete var_;
@@ -58,10 +55,7 @@ OpExp::~OpExp() {
   delete right_;
 }
 
-RecordExp::~RecordExp() {
-  delete typ_;
-  delete fields_;
-}
+RecordExp::~RecordExp() { delete fields_; }
 
 SeqExp::~SeqExp() { delete seq_; }
 
@@ -91,29 +85,21 @@ LetExp::~LetExp() {
 }
 
 ArrayExp::~ArrayExp() {
-  delete typ_;
   delete size_;
   delete init_;
 }
 
 VoidExp::~VoidExp() = default;
 
-EField::~EField() {
-  delete name_;
-  delete exp_;
-}
+EField::~EField() { delete exp_; }
 
 FunctionDec::~FunctionDec() { delete functions_; }
 
-VarDec::~VarDec() {
-  delete var_;
-  delete typ_;
-  delete init_;
-}
+VarDec::~VarDec() { delete init_; }
 
 TypeDec::~TypeDec() { delete types_; }
 
-NameTy::~NameTy() { delete name_; }
+NameTy::~NameTy() = default;
 
 RecordTy::~RecordTy() { delete record_; }
 
@@ -379,7 +365,7 @@ type::TyList *FieldList::MakeFormalTyList(env::TEnvPtr tenv,
 
     if (!ty) {
       errormsg->Error(param->pos_, "undefined type %s",
-                      param->typ_->Name().c_str());
+                      param->typ_->Name().data());
     }
     formal_tylist->Append(ty);
   }
@@ -399,7 +385,7 @@ type::FieldList *FieldList::MakeFieldList(env::TEnvPtr tenv,
     type::Ty *ty = tenv->Look(a_field->typ_);
     if (ty == nullptr) {
       errormsg->Error(a_field->pos_, "undefined type %s",
-                      a_field->typ_->Name().c_str());
+                      a_field->typ_->Name().data());
     }
     ty_field_list->Append(new type::Field(a_field->name_, ty));
   }
@@ -11,6 +11,7 @@
 #include "tiger/frame/frame.h"
 #include "tiger/semant/types.h"
 #include "tiger/symbol/symbol.h"
+#include "tiger/util/arena.h"
 
 /**
  * Forward Declarations
@@ -78,7 +79,7 @@ class AbsynTree {
  * Variables
  */
 
-class Var {
+class Var : public arena::ArenaObject<Var> {
  public:
   int pos_;
   virtual ~Var() = default;
@@ -150,7 +151,7 @@ class SubscriptVar : public Var {
  * Expressions
  */
 
-class Exp {
+class Exp : public arena::ArenaObject<Exp> {
  public:
   int pos_;
   virtual ~Exp() = default;
@@ -439,7 +440,7 @@ class VoidExp : public Exp {
  * Declarations
  */
 
-class Dec {
+class Dec : public arena::ArenaObject<Dec> {
  public:
   int pos_;
   virtual ~Dec() = default;
@@ -512,7 +513,7 @@ class TypeDec : public Dec {
  * Types
  */
 
-class Ty {
+class Ty : public arena::ArenaObject<Ty> {
  public:
   int pos_;
   virtual ~Ty() = default;
@@ -572,7 +573,7 @@ class ArrayTy : public Ty {
  * Linked lists and nodes of lists
  */
 
-class Field {
+class Field : public arena::ArenaObject<Field> {
  public:
   int pos_;
   sym::Symbol *name_, *typ_;
@@ -584,7 +585,7 @@ class Field {
   void Print(FILE *out, int d) const;
 };
 
-class FieldList {
+class FieldList : public arena::ArenaObject<FieldList> {
  public:
   FieldList() = default;
   explicit FieldList(Field *field) : field_list_({field}) { assert(field); }
@@ -606,7 +607,7 @@ class FieldList {
   std::list<Field *> field_list_;
 };
 
-class ExpList {
+class ExpList : public arena::ArenaObject<ExpList> {
  public:
   ExpList() = default;
   explicit ExpList(Exp *exp) : exp_list_({exp}) { assert(exp); }
@@ -622,7 +623,7 @@ class ExpList {
   std::list<Exp *> exp_list_;
 };
 
-class FunDec {
+class FunDec : public arena::ArenaObject<FunDec> {
  public:
   int pos_;
   sym::Symbol *name_;
@@ -639,7 +640,7 @@ class FunDec {
   void Print(FILE *out, int d) const;
 };
 
-class FunDecList {
+class FunDecList : public arena::ArenaObject<FunDecList> {
  public:
   explicit FunDecList(FunDec *fun_dec) : fun_dec_list_({fun_dec}) {
     assert(fun_dec);
@@ -658,7 +659,7 @@ class FunDecList {
   std::list<FunDec *> fun_dec_list_;
 };
 
-class DecList {
+class DecList : public arena::ArenaObject<DecList> {
  public:
   DecList() = default;
   explicit DecList(Dec *dec) : dec_list_({dec}) { assert(dec); }
@@ -674,7 +675,7 @@ class DecList {
   std::list<Dec *> dec_list_;
 };
 
-class NameAndTy {
+class NameAndTy : public arena::ArenaObject<NameAndTy> {
  public:
   sym::Symbol *name_;
   Ty *ty_;
@@ -684,7 +685,7 @@ class NameAndTy {
   void Print(FILE *out, int d) const;
 };
 
-class NameAndTyList {
+class NameAndTyList : public arena::ArenaObject<NameAndTyList> {
  public:
   explicit NameAndTyList(NameAndTy *name_and_ty)
       : name_and_ty_list_({name_and_ty}) {}
@@ -702,7 +703,7 @@ class NameAndTyList {
   std::list<NameAndTy *> name_and_ty_list_;
 };
 
-class EField {
+class EField : public arena::ArenaObject<EField> {
  public:
   sym::Symbol *name_;
   Exp *exp_;
@@ -717,7 +718,7 @@ class EField {
   void Print(FILE *out, int d) const;
 };
 
-class EFieldList {
+class EFieldList : public arena::ArenaObject<EFieldList> {
  public:
   EFieldList() = default;
   explicit EFieldList(EField *efield) : efield_list_({efield}) {}
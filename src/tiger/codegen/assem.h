@@ -6,17 +6,18 @@
 #include <vector>
 
 #include "tiger/frame/temp.h"
+#include "tiger/util/arena.h"
 
 namespace assem {
 
-class Targets {
+class Targets : public arena::ArenaObject<Targets> {
  public:
   std::vector<temp::Label *> *labels_;
 
   explicit Targets(std::vector<temp::Label *> *labels) : labels_(labels) {}
 };
 
-class Instr {
+class Instr : public arena::ArenaObject<Instr, true> {
  public:
   virtual ~Instr() = default;
 
@@ -66,7 +67,7 @@ class MoveInstr : public Instr {
   [[nodiscard]] temp::TempList *Use() const override;
 };
 
-class InstrList {
+class InstrList : public arena::ArenaObject<InstrList, true> {
  public:
   InstrList() = default;
 
@@ -1,25 +1,43 @@
 #include "tiger/codegen/codegen.h"
 
+#include "tiger/runtime/gc/alloc/alloc.h"
+#include "tiger/runtime/gc/barrier/barrier.h"
+
 extern frame::RegManager *reg_manager;
 extern std::vector<std::string> functions_ret_ptr;
 
-std::vector<int> pointer_in_frame_offset;
-std::vector<int> pointer_in_arg;
-
 namespace {
 
 constexpr int maxlen = 1024;
 
+/* 本线程正在生成的函数, Munch通过它访问ProcContext */
+thread_local cg::ProcContext *context = nullptr;
+
 }  // namespace
 
 namespace cg {
 
-std::map<std::string, temp::Temp *> str_tempReg_map;
+bool isPointer(temp::Temp *temp) {
+  if (reg_manager->getTempMap()->Look(temp))
+    return context->pointer_regs.count(temp);
+  return temp->storePointer;
+}
+
+/* 普通temp的指针属性只置位不清除: tiger变量的类型不变, 而函数入口处
+   参数寄存器的指针属性未知, 视图转换的movq不能清掉指针参数的属性 */
+void setPointer(temp::Temp *temp, bool is_pointer) {
+  if (!reg_manager->getTempMap()->Look(temp)) {
+    if (is_pointer) temp->storePointer = true;
+  } else if (is_pointer)
+    context->pointer_regs.insert(temp);
+  else
+    context->pointer_regs.erase(temp);
+}
 
 /***************** For GC *****************/
 
 /* 指针传递规则：
-    (1) movq的dst的指针属性和src相同
+    (1) movq若src为pointer则dst为pointer(机器寄存器的属性和src相同)
     (2) addq/subq若src中的一个为pointer则dst为pointer,
     (3) subq若src中的两个均为pointer则dst不是pointer(tiger中不涉及)
 */
@@ -28,6 +46,7 @@ std::map<std::string, temp::Temp *> str_tempReg_map;
     (1) 帧中存储指针的位置
     (2) call返回指针的函数的%rax
     (3) 函数参数中传入的指针
+    (4) 从内联分配指针tiger_alloc_ptr读出的地址
   除此之外寄存器中的指针均为传递而来
 */
 
@@ -36,8 +55,8 @@ void pointerTransfer(assem::Instr *instr) {
   if (typeid(*instr) == typeid(assem::MoveInstr)) {
     assem::MoveInstr *mov_ins = static_cast<assem::MoveInstr *>(instr);
     if (mov_ins->dst_ && mov_ins->src_)
-      mov_ins->dst_->GetList().front()->storePointer =
-          mov_ins->src_->GetList().front()->storePointer;
+      setPointer(mov_ins->dst_->GetList().front(),
+                 isPointer(mov_ins->src_->GetList().front()));
   }
   // addq中指针的传递
   if (typeid(*instr) == typeid(assem::OperInstr)) {
@@ -45,8 +64,8 @@ void pointerTransfer(assem::Instr *instr) {
     if ((add_ins->assem_.find("add") != add_ins->assem_.npos ||
          add_ins->assem_.find("sub") != add_ins->assem_.npos) &&
         add_ins->dst_ && add_ins->src_ &&
-        add_ins->src_->GetList().front()->storePointer)
-      add_ins->dst_->GetList().front()->storePointer = true;
+        isPointer(add_ins->src_->GetList().front()))
+      setPointer(add_ins->dst_->GetList().front(), true);
   }
 }
 
@@ -59,7 +78,7 @@ void generatePointRoot(frame::Frame *frame_) {
   for (frame::Access *access : *InframeFormals) {
     if (typeid(*access) == typeid(frame::InFrameAccess) &&
         static_cast<frame::InFrameAccess *>(access)->storePointer)
-      pointer_in_frame_offset.push_back(
+      context->pointer_in_frame_offset.push_back(
           static_cast<frame::InFrameAccess *>(access)->offset);
   }
   auto iter = (*InframeFormals).begin();
@@ -68,25 +87,29 @@ void generatePointRoot(frame::Frame *frame_) {
     frame::Access *access = *iter;
     if (typeid(*access) == typeid(frame::InRegAccess) &&
         static_cast<frame::InRegAccess *>(access)->reg->storePointer)
-      pointer_in_arg.push_back(pos);
+      context->pointer_in_arg.push_back(pos);
   }
 }
 
 bool argIsPointer(int pos) {
-  return std::find(pointer_in_arg.begin(), pointer_in_arg.end(), pos) !=
-         pointer_in_arg.end();
+  return std::find(context->pointer_in_arg.begin(),
+                   context->pointer_in_arg.end(),
+                   pos) != context->pointer_in_arg.end();
 }
 
 bool returnValueIsPointer(std::string func_name) {
+  // 分配heap对象的runtime函数, 以及返回string的内建函数
   return func_name == "init_array" || func_name == "alloc_record" ||
+         func_name == "concat" || func_name == "substring" ||
+         func_name == "chr" || func_name == "getchar" ||
          std::find(functions_ret_ptr.begin(), functions_ret_ptr.end(),
                    func_name) != functions_ret_ptr.end();
 }
 
 bool inFrameValueIsPointer(int offset) {
-  return std::find(pointer_in_frame_offset.begin(),
-                   pointer_in_frame_offset.end(),
-                   offset) != pointer_in_frame_offset.end();
+  return std::find(context->pointer_in_frame_offset.begin(),
+                   context->pointer_in_frame_offset.end(),
+                   offset) != context->pointer_in_frame_offset.end();
 }
 
 /***************** End For GC *****************/
@@ -115,12 +138,40 @@ void emit(assem::Instr *instr, assem::InstrList &instr_list_) {
   instr_list_.Append(instr);
 }
 
+/* 写屏障: 标记被写地址所在的card, 分代GC的MinorGC只扫描被标记的card.
+ * 卡号寄存器不是指针, 用OperInstr复制以免传递指针属性 */
+void emitWriteBarrier(temp::Temp *addr, assem::InstrList &instr_list) {
+  temp::Temp *card = temp::TempFactory::NewTemp();
+  temp::Temp *table = temp::TempFactory::NewTemp();
+  emit(new assem::OperInstr("movq `s0, `d0", new temp::TempList(card),
+                            new temp::TempList(addr), nullptr),
+       instr_list);
+  emit(new assem::OperInstr("shrq $" + std::to_string(gc::CARD_SHIFT) +
+                                ", `d0",
+                            new temp::TempList(card),
+                            new temp::TempList(card), nullptr),
+       instr_list);
+  emit(new assem::OperInstr("andq $" +
+                                std::to_string(gc::CARD_TABLE_SIZE - 1) +
+                                ", `d0",
+                            new temp::TempList(card),
+                            new temp::TempList(card), nullptr),
+       instr_list);
+  emit(new assem::OperInstr("leaq " + std::string(gc::CARD_TABLE_SYMBOL) +
+                                "(%rip), `d0",
+                            new temp::TempList(table), nullptr, nullptr),
+       instr_list);
+  emit(new assem::OperInstr("movb $1, (`s0,`s1)", nullptr,
+                            new temp::TempList({table, card}), nullptr),
+       instr_list);
+}
+
 void saveCalleeSavedRegs(assem::InstrList &instr_list) {
   std::list<temp::Temp *> callee_save = reg_manager->CalleeSaves()->GetList();
   for (temp::Temp *reg : callee_save) {
     temp::Temp *reg_to_save_in = temp::TempFactory::NewTemp();
     std::string reg_name = *(reg_manager->getTempMap()->Look(reg));
-    cg::str_tempReg_map[reg_name] = reg_to_save_in;
+    context->str_tempReg_map[reg_name] = reg_to_save_in;
 
     temp::TempList *src = new temp::TempList(reg);
     temp::TempList *dst = new temp::TempList(reg_to_save_in);
@@ -133,7 +184,7 @@ void restoreCalleeSavedRegs(assem::InstrList &instr_list) {
   std::list<temp::Temp *> callee_save = reg_manager->CalleeSaves()->GetList();
   for (temp::Temp *reg : callee_save) {
     std::string reg_name = *(reg_manager->getTempMap()->Look(reg));
-    temp::Temp *reg_to_save_in = cg::str_tempReg_map[reg_name];
+    temp::Temp *reg_to_save_in = context->str_tempReg_map[reg_name];
 
     temp::TempList *src = new temp::TempList(reg_to_save_in);
     temp::TempList *dst = new temp::TempList(reg);
@@ -144,8 +195,9 @@ void restoreCalleeSavedRegs(assem::InstrList &instr_list) {
 
 void CodeGen::Codegen() {
   assem::InstrList instr_list_;
-  fs_ = frame_->lable_->Name() + "_framesize";
+  fs_ = std::string(frame_->lable_->Name()) + "_framesize";
   std::list<tree::Stm *> function_stms = traces_.get()->GetStmList()->GetList();
+  context = &context_;
 
   // For GC
   generatePointRoot(frame_);
@@ -159,6 +211,7 @@ void CodeGen::Codegen() {
   for (auto ins : instr_list_.GetList()) new_ins_list->Append(ins);
 
   assem_instr_ = std::make_unique<AssemInstr>(new_ins_list);
+  context = nullptr;
 }
 
 void AssemInstr::Print(FILE *out, temp::Map *map) const {
@@ -289,6 +342,10 @@ void MoveStm::Munch(assem::InstrList &instr_list, std::string_view fs) {
     assem::Instr *instr = new assem::OperInstr(
         ass, nullptr, new temp::TempList({src_reg, dst_addr_reg}), nullptr);
     cg::emit(instr, instr_list);
+    // 常数和label不会是指向nursery的指针
+    if (barrier_ && typeid(*src_) != typeid(tree::ConstExp) &&
+        typeid(*src_) != typeid(tree::NameExp))
+      cg::emitWriteBarrier(dst_addr_reg, instr_list);
   } else {
     temp::Temp *dst_reg = dst_->Munch(instr_list, fs);
     std::string ass = "movq `s0, `d0";
@@ -450,6 +507,11 @@ temp::Temp *MemExp::Munch(assem::InstrList &instr_list, std::string_view fs) {
       return dst_reg;
     }
   }
+  // For GC, 指针根(4)
+  if (typeid(*exp_) == typeid(tree::NameExp) &&
+      static_cast<tree::NameExp *>(exp_)->name_->Name() ==
+          gc::ALLOC_PTR_SYMBOL)
+    dst_reg->storePointer = true;
   temp::Temp *addr_reg = exp_->Munch(instr_list, fs);
   assem::Instr *mem_ins =
       new assem::OperInstr("movq (`s0), `d0", new temp::TempList({dst_reg}),
@@ -477,7 +539,7 @@ temp::Temp *EseqExp::Munch(assem::InstrList &instr_list, std::string_view fs) {
 
 temp::Temp *NameExp::Munch(assem::InstrList &instr_list, std::string_view fs) {
   temp::Temp *dst_rip_reg = temp::TempFactory::NewTemp();
-  std::string ass_lea = "leaq " + name_->Name() + "(%rip), `d0";
+  std::string ass_lea = "leaq " + std::string(name_->Name()) + "(%rip), `d0";
   assem::Instr *ins_getRIP = new assem::OperInstr(
       ass_lea, new temp::TempList({dst_rip_reg}), nullptr, nullptr);
   cg::emit(ins_getRIP, instr_list);
@@ -494,7 +556,7 @@ temp::Temp *ConstExp::Munch(assem::InstrList &instr_list, std::string_view fs) {
 }
 
 temp::Temp *CallExp::Munch(assem::InstrList &instr_list, std::string_view fs) {
-  std::string funcName = static_cast<tree::NameExp *>(fun_)->name_->Name();
+  std::string funcName(static_cast<tree::NameExp *>(fun_)->name_->Name());
 
   temp::TempList *arg_Regs = args_->MunchArgs(instr_list, fs);
 
@@ -515,7 +577,8 @@ temp::Temp *CallExp::Munch(assem::InstrList &instr_list, std::string_view fs) {
   temp::Temp *ret_reg = temp::TempFactory::NewTemp();
 
   // For GC, 指针根(2)
-  reg_manager->ReturnValue()->storePointer = cg::returnValueIsPointer(funcName);
+  cg::setPointer(reg_manager->ReturnValue(),
+                 cg::returnValueIsPointer(funcName));
 
   std::string ass_mov_ret = "movq `s0, `d0";
   assem::Instr *ins_mov =
@@ -539,7 +602,7 @@ temp::TempList *ExpList::MunchArgs(assem::InstrList &instr_list,
       args_Regs->Append(reg_manager->ArgRegs()->NthTemp(i));
 
       // For GC:指针根(3)
-      reg_manager->ArgRegs()->NthTemp(i)->storePointer = cg::argIsPointer(i);
+      cg::setPointer(reg_manager->ArgRegs()->NthTemp(i), cg::argIsPointer(i));
 
       assem::Instr *ins_mov = new assem::MoveInstr(
           ass_mov, new temp::TempList(reg_manager->ArgRegs()->NthTemp(i)),
@@ -2,7 +2,10 @@
 #define TIGER_CODEGEN_CODEGEN_H_
 
 #include <cassert>
+#include <map>
+#include <set>
 #include <sstream>
+#include <vector>
 
 #include "tiger/canon/canon.h"
 #include "tiger/codegen/assem.h"
@@ -25,6 +28,20 @@ class Traces;
 
 namespace cg {
 
+/* 一个函数代码生成期间的状态, 由该函数的CodeGen独占,
+   不同函数可以在不同线程中同时生成 */
+struct ProcContext {
+  /* 帧中存储指针的位置 */
+  std::vector<int> pointer_in_frame_offset;
+  /* 存储指针的参数的序号 */
+  std::vector<int> pointer_in_arg;
+  /* callee saved寄存器名 -> 函数入口保存它的temp */
+  std::map<std::string, temp::Temp *> str_tempReg_map;
+  /* 当前存放指针的机器寄存器. 机器寄存器的Temp为所有函数共享,
+     其storePointer不能在代码生成中修改 */
+  std::set<temp::Temp *> pointer_regs;
+};
+
 class AssemInstr {
  public:
   AssemInstr() = delete;
@@ -51,6 +68,7 @@ class CodeGen {
 
  private:
   frame::Frame *frame_;
+  ProcContext context_;
   std::string fs_;  // Frame size label_
   std::unique_ptr<canon::Traces> traces_;
   std::unique_ptr<AssemInstr> assem_instr_;
@@ -13,6 +13,10 @@
  * 增加 Access::setStorePointer()函数, 用于设置Access为存储指针
 */
 
+namespace gc {
+struct PointerMap;
+}  // namespace gc
+
 namespace frame {
 
 class RegManager {
@@ -141,6 +145,14 @@ class ProcFrag : public Frag {
   ProcFrag(tree::Stm *body, Frame *frame) : body_(body), frame_(frame) {}
 
   void OutputAssem(FILE *out, OutputPhase phase, bool need_ra) const override;
+
+  /**
+   * Generate assembly of this function only, the pointer maps of its call
+   * sites are appended to maps instead of the global roots. Different procs
+   * can be generated concurrently.
+   */
+  void OutputProc(FILE *out, bool need_ra,
+                  std::vector<gc::PointerMap> *maps) const;
 };
 
 class Frags {
@@ -7,12 +7,22 @@
 namespace temp {
 
 LabelFactory LabelFactory::label_factory;
+thread_local LabelFactory *LabelFactory::current_ = nullptr;
 TempFactory TempFactory::temp_factory;
 
 Label *LabelFactory::NewLabel() {
-  char buf[100];
-  sprintf(buf, "L%d", label_factory.label_id_++);
-  return NamedLabel(std::string(buf));
+  LabelFactory *factory = current_ ? current_ : &label_factory;
+  return NamedLabel(factory->prefix_ + std::to_string(factory->label_id_++));
+}
+
+LabelFactory::Scope::Scope(std::string prefix) : saved_(current_) {
+  current_ = new LabelFactory();
+  current_->prefix_ = std::move(prefix);
+}
+
+LabelFactory::Scope::~Scope() {
+  delete current_;
+  current_ = saved_;
 }
 
 /**
@@ -24,7 +34,9 @@ Label *LabelFactory::NamedLabel(std::string_view s) {
   return sym::Symbol::UniqueSymbol(s);
 }
 
-std::string LabelFactory::LabelString(Label *s) { return s->Name(); }
+std::string LabelFactory::LabelString(Label *s) {
+  return std::string(s->Name());
+}
 
 Temp *TempFactory::NewTemp() {
   Temp *p = new Temp(temp_factory.temp_id_++);
@@ -40,10 +52,15 @@ int Temp::Int() const { return num_; }
 
 Map *Map::Empty() { return new Map(); }
 
+/* 并行生成时各线程的NewTemp同时向Name()加入绑定, Enter可能重新分配tab_,
+ * 因此对它的查找也要加锁 */
 Map *Map::Name() {
-  static Map *m = nullptr;
-  if (!m)
-    m = Empty();
+  static std::mutex name_mutex;
+  static Map *m = [] {
+    Map *map = Empty();
+    map->mutex_ = &name_mutex;
+    return map;
+  }();
   return m;
 }
 
@@ -51,18 +68,24 @@ Map *Map::LayerMap(Map *over, Map *under) {
   if (over == nullptr)
     return under;
   else
-    return new Map(over->tab_, LayerMap(over->under_, under));
+    return new Map(over->tab_, LayerMap(over->under_, under), over->mutex_);
 }
 
 void Map::Enter(Temp *t, std::string *s) {
   assert(tab_);
+  std::unique_lock<std::mutex> lock;
+  if (mutex_) lock = std::unique_lock<std::mutex>(*mutex_);
   tab_->Enter(t, s);
 }
 
 std::string *Map::Look(Temp *t) {
   std::string *s;
   assert(tab_);
-  s = tab_->Look(t);
+  {
+    std::unique_lock<std::mutex> lock;
+    if (mutex_) lock = std::unique_lock<std::mutex>(*mutex_);
+    s = tab_->Look(t);
+  }
   if (s)
     return s;
   else if (under_)
@@ -72,11 +95,14 @@ std::string *Map::Look(Temp *t) {
 }
 
 void Map::DumpMap(FILE *out) {
+  std::unique_lock<std::mutex> lock;
+  if (mutex_) lock = std::unique_lock<std::mutex>(*mutex_);
   tab_->Dump([out](temp::Temp *t, std::string *r) {
     fprintf(out, "t%d -> %s\n", t->Int(), r->data());
   });
   if (under_) {
     fprintf(out, "---------\n");
+    if (lock) lock.unlock();
     under_->DumpMap(out);
   }
 }
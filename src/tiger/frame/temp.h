@@ -1,10 +1,14 @@
 #ifndef TIGER_FRAME_TEMP_H_
 #define TIGER_FRAME_TEMP_H_
 
+#include <atomic>
 #include <list>
+#include <mutex>
+#include <string>
 #include <string_view>
 
 #include "tiger/symbol/symbol.h"
+#include "tiger/util/arena.h"
 
 /* lab7 GC改动说明:
  * 增加 Temp::storePointer, 用于保存storePointer是否为指针
@@ -20,9 +24,24 @@ class LabelFactory {
   static Label *NamedLabel(std::string_view name);
   static std::string LabelString(Label *s);
 
+  /* 作用域内本线程NewLabel得到"<prefix><n>", 编号从0开始.
+     各函数的后端使用各自的前缀, 可以并行生成且标号与生成顺序无关 */
+  class Scope {
+   public:
+    explicit Scope(std::string prefix);
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+    ~Scope();
+
+   private:
+    LabelFactory *saved_;
+  };
+
  private:
+  std::string prefix_ = "L";
   int label_id_ = 0;
   static LabelFactory label_factory;
+  static thread_local LabelFactory *current_;
 };
 
 class Temp {
@@ -49,7 +68,7 @@ class TempFactory {
   static Temp *NewTemp();
 
  private:
-  int temp_id_ = 100;
+  std::atomic<int> temp_id_{100};
   static TempFactory temp_factory;
 };
 
@@ -62,17 +81,30 @@ class Map {
   static Map *Empty();
   static Map *Name();
   static Map *LayerMap(Map *over, Map *under);
-  Map() : tab_(new tab::Table<Temp, std::string>()), under_(nullptr) {}
+  Map()
+      : tab_(new tab::Table<Temp, std::string>()),
+        under_(nullptr),
+        owns_tab_(true),
+        mutex_(nullptr) {}
+  Map(const Map &) = delete;
+  Map &operator=(const Map &) = delete;
+  /* LayerMap产生的map与原map共用tab_, 只有原map释放它 */
+  ~Map() {
+    if (owns_tab_) delete tab_;
+  }
 
  private:
   tab::Table<Temp, std::string> *tab_;
   Map *under_;
+  bool owns_tab_;
+  /* 非空时对tab_的访问都要加锁, 见Name() */
+  std::mutex *mutex_;
 
-  Map(tab::Table<Temp, std::string> *tab, Map *under)
-      : tab_(tab), under_(under) {}
+  Map(tab::Table<Temp, std::string> *tab, Map *under, std::mutex *mutex)
+      : tab_(tab), under_(under), owns_tab_(false), mutex_(mutex) {}
 };
 
-class TempList {
+class TempList : public arena::ArenaObject<TempList, true> {
  public:
   explicit TempList(Temp *t) : temp_list_({t}) {}
   TempList(std::initializer_list<Temp *> list) : temp_list_(list) {}
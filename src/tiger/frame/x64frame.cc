@@ -94,78 +94,80 @@ temp::Temp* X64RegManager::GetRegister(int regno) { return regs_[regno]; }
 
 temp::TempList* X64RegManager::Registers() {
   temp::TempList* tempList = new temp::TempList();
-  tempList->Append(str_map_["%rax"]);
-  tempList->Append(str_map_["%rdi"]);
-  tempList->Append(str_map_["%rsi"]);
-  tempList->Append(str_map_["%rdx"]);
-  tempList->Append(str_map_["%rcx"]);
-  tempList->Append(str_map_["%rbx"]);
-  tempList->Append(str_map_["%rbp"]);
+  tempList->Append(str_map_.at("%rax"));
+  tempList->Append(str_map_.at("%rdi"));
+  tempList->Append(str_map_.at("%rsi"));
+  tempList->Append(str_map_.at("%rdx"));
+  tempList->Append(str_map_.at("%rcx"));
+  tempList->Append(str_map_.at("%rbx"));
+  tempList->Append(str_map_.at("%rbp"));
 
-  tempList->Append(str_map_["%r8"]);
-  tempList->Append(str_map_["%r9"]);
-  tempList->Append(str_map_["%r10"]);
-  tempList->Append(str_map_["%r11"]);
-  tempList->Append(str_map_["%r12"]);
-  tempList->Append(str_map_["%r13"]);
-  tempList->Append(str_map_["%r14"]);
-  tempList->Append(str_map_["%r15"]);
+  tempList->Append(str_map_.at("%r8"));
+  tempList->Append(str_map_.at("%r9"));
+  tempList->Append(str_map_.at("%r10"));
+  tempList->Append(str_map_.at("%r11"));
+  tempList->Append(str_map_.at("%r12"));
+  tempList->Append(str_map_.at("%r13"));
+  tempList->Append(str_map_.at("%r14"));
+  tempList->Append(str_map_.at("%r15"));
   return tempList;
 }
 
 temp::TempList* X64RegManager::ArgRegs() {
   temp::TempList* tempList = new temp::TempList();
-  tempList->Append(str_map_["%rdi"]);
-  tempList->Append(str_map_["%rsi"]);
-  tempList->Append(str_map_["%rdx"]);
-  tempList->Append(str_map_["%rcx"]);
-  tempList->Append(str_map_["%r8"]);
-  tempList->Append(str_map_["%r9"]);
+  tempList->Append(str_map_.at("%rdi"));
+  tempList->Append(str_map_.at("%rsi"));
+  tempList->Append(str_map_.at("%rdx"));
+  tempList->Append(str_map_.at("%rcx"));
+  tempList->Append(str_map_.at("%r8"));
+  tempList->Append(str_map_.at("%r9"));
   return tempList;
 }
 
 temp::TempList* X64RegManager::CallerSaves() {
   temp::TempList* tempList = new temp::TempList();
-  tempList->Append(str_map_["%rax"]);
-  tempList->Append(str_map_["%rdi"]);
-  tempList->Append(str_map_["%rsi"]);
-  tempList->Append(str_map_["%rdx"]);
-  tempList->Append(str_map_["%rcx"]);
-  tempList->Append(str_map_["%r8"]);
-  tempList->Append(str_map_["%r9"]);
-  tempList->Append(str_map_["%r10"]);
-  tempList->Append(str_map_["%r11"]);
+  tempList->Append(str_map_.at("%rax"));
+  tempList->Append(str_map_.at("%rdi"));
+  tempList->Append(str_map_.at("%rsi"));
+  tempList->Append(str_map_.at("%rdx"));
+  tempList->Append(str_map_.at("%rcx"));
+  tempList->Append(str_map_.at("%r8"));
+  tempList->Append(str_map_.at("%r9"));
+  tempList->Append(str_map_.at("%r10"));
+  tempList->Append(str_map_.at("%r11"));
   return tempList;
 }
 
 temp::TempList* X64RegManager::CalleeSaves() {
   temp::TempList* tempList = new temp::TempList();
-  tempList->Append(str_map_["%rbx"]);
-  tempList->Append(str_map_["%rbp"]);
-  tempList->Append(str_map_["%r12"]);
-  tempList->Append(str_map_["%r13"]);
-  tempList->Append(str_map_["%r14"]);
-  tempList->Append(str_map_["%r15"]);
+  tempList->Append(str_map_.at("%rbx"));
+  tempList->Append(str_map_.at("%rbp"));
+  tempList->Append(str_map_.at("%r12"));
+  tempList->Append(str_map_.at("%r13"));
+  tempList->Append(str_map_.at("%r14"));
+  tempList->Append(str_map_.at("%r15"));
   return tempList;
 }
 
 temp::TempList* X64RegManager::ReturnSink() {
   temp::TempList* tempList = new temp::TempList();
-  tempList->Append(str_map_["%rax"]);
+  tempList->Append(str_map_.at("%rax"));
   return tempList;
 }
 
 int X64RegManager::WordSize() { return 8; }
 int X64RegManager::Regnumber() { return 15; }
 
-temp::Temp* X64RegManager::FramePointer() { return str_map_["%rbp"]; }
+temp::Temp* X64RegManager::FramePointer() { return str_map_.at("%rbp"); }
 
-temp::Temp* X64RegManager::StackPointer() { return str_map_["%rsp"]; }
+temp::Temp* X64RegManager::StackPointer() { return str_map_.at("%rsp"); }
 
-temp::Temp* X64RegManager::ReturnValue() { return str_map_["%rax"]; }
+temp::Temp* X64RegManager::ReturnValue() { return str_map_.at("%rax"); }
 
+/* 后端各线程共享, 只读不插入 */
 temp::Temp* X64RegManager::findByName(std::string name) {
-  return str_map_[name];
+  auto it = str_map_.find(name);
+  return it == str_map_.end() ? nullptr : it->second;
 }
 
 temp::Map* X64RegManager::getTempMap() { return temp_map_; }
@@ -268,9 +270,12 @@ void procEntryExit2(assem::InstrList& body) {
 assem::Proc* procEntryExit3(frame::Frame* frame_, assem::InstrList* body) {
   std::string prelog;
   std::string epilog;
-  std::string function_name = frame_->lable_->Name();
+  std::string function_name(frame_->lable_->Name());
   int spaceForArg = (frame_->maxCallargs > 6) ? frame_->maxCallargs - 6 : 0;
   int framesize = -frame_->offset + spaceForArg * reg_manager->WordSize();
+  // call指令处%rsp按16字节对齐(System V ABI), 运行时的C函数依赖这一点
+  if ((framesize + reg_manager->WordSize()) % 16)
+    framesize += reg_manager->WordSize();
   prelog += function_name + ":\n";
   prelog += ".set " + function_name + "_framesize, " +
             std::to_string(framesize) + "\n";
@@ -22,6 +22,9 @@ class FlowGraphFactory {
       : instr_list_(instr_list),
         flowgraph_(new FGraph()),
         label_map_(std::make_unique<tab::Table<temp::Label, FNode>>()) {}
+  FlowGraphFactory(const FlowGraphFactory &) = delete;
+  FlowGraphFactory &operator=(const FlowGraphFactory &) = delete;
+  ~FlowGraphFactory() { delete flowgraph_; }
   void AssemFlowGraph();
   FGraphPtr GetFlowGraph() { return flowgraph_; }
 
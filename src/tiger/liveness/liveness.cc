@@ -1,6 +1,8 @@
 #include "tiger/liveness/liveness.h"
 
 #include <iostream>
+#include <set>
+#include <unordered_set>
 
 extern frame::RegManager *reg_manager;
 
@@ -41,6 +43,40 @@ MoveList *MoveList::Intersect(MoveList *list) {
   return res;
 }
 
+INodePtr IGraph::NewNode(temp::Temp *info, bool precolored) {
+  INodePtr node = node_store_.NewNode(info);
+  nodes_.push_back(node);
+  precolored_.push_back(precolored);
+  adj_list_.emplace_back();
+  degree_.push_back(0);
+
+  uint64_t node_num = nodes_.size();
+  adj_set_.resize((node_num * (node_num - 1) / 2 + 63) / 64, 0);
+  return node;
+}
+
+void IGraph::AddEdge(INodePtr u, INodePtr v) {
+  assert(u && v);
+  uint64_t i = u->Key(), j = v->Key();
+  if (i == j) return;
+  uint64_t bit = i > j ? BitIndex(i, j) : BitIndex(j, i);
+  uint64_t mask = (uint64_t)1 << (bit & 63);
+  if (adj_set_[bit >> 6] & mask) return;
+  adj_set_[bit >> 6] |= mask;
+  edge_count_++;
+  degree_[i]++;
+  degree_[j]++;
+  if (!precolored_[i]) adj_list_[i].push_back(v);
+  if (!precolored_[j]) adj_list_[j].push_back(u);
+}
+
+bool IGraph::Adj(INodePtr u, INodePtr v) const {
+  uint64_t i = u->Key(), j = v->Key();
+  if (i == j) return false;
+  uint64_t bit = i > j ? BitIndex(i, j) : BitIndex(j, i);
+  return (adj_set_[bit >> 6] >> (bit & 63)) & 1;
+}
+
 /* 并集 */
 temp::TempList *Union(temp::TempList *list_1, temp::TempList *list_2) {
   temp::TempList *res = new temp::TempList();
@@ -89,86 +125,209 @@ bool Changed(temp::TempList *prev, temp::TempList *curr) {
   return false;
 }
 
-void LiveGraphFactory::LiveMap() {
-  std::list<fg::FNodePtr> flowgrapg_nodes = flowgraph_->Nodes()->GetList();
-  std::map<fg::FNodePtr, temp::TempList *> in, pre_in, out, pre_out;
+/* 为流图中出现的全部temp分配稠密编号, 并缓存每条指令的use/def */
+void LiveGraphFactory::NumberTemps() {
+  const std::list<fg::FNodePtr> &flowgrapg_nodes =
+      flowgraph_->Nodes()->GetList();
+  auto number = [this](temp::Temp *temp_) {
+    if (temp_index_.find(temp_) == temp_index_.end()) {
+      temp_index_[temp_] = (int)index_temp_.size();
+      index_temp_.push_back(temp_);
+    }
+  };
+  for (fg::FNodePtr node_ : flowgrapg_nodes) {
+    assem::Instr *node_ins = node_->NodeInfo();
+    for (temp::Temp *temp_ : node_ins->Use()->GetList()) number(temp_);
+    for (temp::Temp *temp_ : node_ins->Def()->GetList()) number(temp_);
+  }
 
-  // initialize in and out
+  int temp_num = (int)index_temp_.size();
+  int node_num = flowgraph_->nodecount_;
+  node_use_.assign(node_num, bitset::BitSet(temp_num));
+  node_def_.assign(node_num, bitset::BitSet(temp_num));
+  node_in_.assign(node_num, bitset::BitSet(temp_num));
+  node_out_.assign(node_num, bitset::BitSet(temp_num));
   for (fg::FNodePtr node_ : flowgrapg_nodes) {
-    in[node_] = new temp::TempList();
-    out[node_] = new temp::TempList();
+    assem::Instr *node_ins = node_->NodeInfo();
+    for (temp::Temp *temp_ : node_ins->Use()->GetList())
+      node_use_[node_->Key()].Set(temp_index_[temp_]);
+    for (temp::Temp *temp_ : node_ins->Def()->GetList())
+      node_def_[node_->Key()].Set(temp_index_[temp_]);
   }
+}
 
-  bool changed = false;
-  do {
-    // for(auto pair_in : pre_in)delete pair_in.second;
-    // for(auto pair_out : pre_out)delete pair_out.second;
-    pre_in = in;
-    pre_out = out;
-    changed = false;
-    for (fg::FNodePtr node_ : flowgrapg_nodes) {
-      assem::Instr *node_ins = node_->NodeInfo();
-      temp::TempList *use_list = node_ins->Use();
-      temp::TempList *def_list = node_ins->Def();
-
-      out[node_] = new temp::TempList();
-      std::list<fg::FNodePtr> succ = node_->Succ()->GetList();
-      for (fg::FNodePtr succ_node : succ) {
-        temp::TempList *old_out = out[node_];
-        out[node_] = Union(old_out, in[succ_node]);
-        delete old_out;
+/* 划分基本块: 一条指令若不是其前一条指令的唯一后继(或它有多个前驱),
+ * 则它是新块的首条指令 */
+BlockSolver::BlockSolver(fg::FGraphPtr flowgraph, int width,
+                         const std::vector<bitset::BitSet> &node_use,
+                         const std::vector<bitset::BitSet> &node_def)
+    : node_use_(node_use), node_def_(node_def) {
+  std::vector<int> block_of(flowgraph->nodecount_, -1);
+  fg::FNodePtr prev = nullptr;
+  for (fg::FNodePtr node_ : flowgraph->Nodes()->GetList()) {
+    bool leader = prev == nullptr || node_->InDegree() != 1 ||
+                  node_->Pred()->GetList().front() != prev ||
+                  prev->OutDegree() != 1;
+    if (leader) {
+      blocks_.emplace_back();
+      LiveBlock &block = blocks_.back();
+      block.use = bitset::BitSet(width);
+      block.def = bitset::BitSet(width);
+      block.in = bitset::BitSet(width);
+      block.out = bitset::BitSet(width);
+    }
+    blocks_.back().nodes.push_back(node_);
+    block_of[node_->Key()] = (int)blocks_.size() - 1;
+    prev = node_;
+  }
+
+  for (int b = 0; b < (int)blocks_.size(); b++) {
+    LiveBlock &block = blocks_[b];
+    for (fg::FNodePtr succ : block.nodes.back()->Succ()->GetList()) {
+      int succ_block = block_of[succ->Key()];
+      block.succs.push_back(succ_block);
+      blocks_[succ_block].preds.push_back(b);
+    }
+    // 逆序合并块内各指令: use = use_i | (use - def_i)
+    for (auto it = block.nodes.rbegin(); it != block.nodes.rend(); it++) {
+      int key = (*it)->Key();
+      block.use.Subtract(node_def_[key]);
+      block.use.UnionWith(node_use_[key]);
+      block.def.UnionWith(node_def_[key]);
+    }
+  }
+}
+
+/* 活跃分析是逆向问题, 按正向流图的后序(即逆流图的逆后序)处理基本块,
+ * 只有后继的in发生变化的块才会重新进入worklist */
+void BlockSolver::SolveBlocks() {
+  int block_num = (int)blocks_.size();
+  if (!block_num) return;
+
+  std::vector<int> order;
+  std::vector<bool> visited(block_num, false);
+  std::vector<std::pair<int, int>> dfs_stack;
+  for (int root = 0; root < block_num; root++) {
+    if (visited[root]) continue;
+    visited[root] = true;
+    dfs_stack.emplace_back(root, 0);
+    while (!dfs_stack.empty()) {
+      auto &top = dfs_stack.back();
+      const std::vector<int> &succs = blocks_[top.first].succs;
+      if (top.second < (int)succs.size()) {
+        int succ = succs[top.second++];
+        if (!visited[succ]) {
+          visited[succ] = true;
+          dfs_stack.emplace_back(succ, 0);
+        }
+      } else {
+        order.push_back(top.first);
+        dfs_stack.pop_back();
       }
-      in[node_] = Union(Difference(out[node_], def_list), use_list);
-      // if(!use_list->GetList().size())delete use_list;
-      // if(!def_list->GetList().size())delete def_list;
-      //判断该点的in和out有无变化
-      if (Changed(in[node_], pre_in[node_]) ||
-          Changed(out[node_], pre_out[node_]))
-        changed = true;
     }
-  } while (changed);
+  }
+
+  std::vector<int> rank(block_num);
+  for (int i = 0; i < block_num; i++) rank[order[i]] = i;
+
+  std::set<int> worklist;
+  for (int i = 0; i < block_num; i++) worklist.insert(i);
+  while (!worklist.empty()) {
+    int b = order[*worklist.begin()];
+    worklist.erase(worklist.begin());
+    iterations_++;
+
+    LiveBlock &block = blocks_[b];
+    for (int succ : block.succs) block.out.UnionWith(blocks_[succ].in);
+    if (block.in.Transfer(block.use, block.out, block.def))
+      for (int pred : block.preds) worklist.insert(rank[pred]);
+  }
+}
+
+void BlockSolver::Solve(std::vector<bitset::BitSet> *node_in,
+                        std::vector<bitset::BitSet> *node_out) {
+  SolveBlocks();
+
+  // 由块的out逆推块内每条指令的in/out
+  for (LiveBlock &block : blocks_) {
+    bitset::BitSet live = block.out;
+    for (auto it = block.nodes.rbegin(); it != block.nodes.rend(); it++) {
+      int key = (*it)->Key();
+      if (node_out) (*node_out)[key] = live;
+      (*node_in)[key].Transfer(node_use_[key], live, node_def_[key]);
+      live = (*node_in)[key];
+    }
+  }
+}
+
+temp::TempList *LiveGraphFactory::ToTempList(const bitset::BitSet &set) {
+  temp::TempList *res = new temp::TempList();
+  set.ForEach([this, res](int i) { res->Append(index_temp_[i]); });
+  return res;
+}
+
+/* spill重写只引入块内的短temp, 其余temp在原指令处的活跃性不变,
+ * 因此块入口处的活跃集合就是prev中该块第一条原有指令的in */
+void LiveGraphFactory::SeedBlocks() {
+  std::unordered_map<assem::Instr *, int> prev_key;
+  for (fg::FNodePtr node_ : prev_->flowgraph_->Nodes()->GetList())
+    prev_key[node_->NodeInfo()] = node_->Key();
+
+  for (LiveBlock &block : solver_->Blocks())
+    for (fg::FNodePtr node_ : block.nodes) {
+      auto it = prev_key.find(node_->NodeInfo());
+      if (it == prev_key.end()) continue;
+      prev_->node_in_[it->second].ForEach([&](int prev_index) {
+        auto index = temp_index_.find(prev_->index_temp_[prev_index]);
+        if (index != temp_index_.end()) block.in.Set(index->second);
+      });
+      break;
+    }
+}
 
-  for (auto in_pair : in) in_->Enter(in_pair.first, in_pair.second);
-  for (auto out_pair : out) out_->Enter(out_pair.first, out_pair.second);
+void LiveGraphFactory::Solve() {
+  NumberTemps();
+  solver_ = std::make_unique<BlockSolver>(flowgraph_, (int)index_temp_.size(),
+                                          node_use_, node_def_);
+  if (prev_) SeedBlocks();
+  solver_->Solve(&node_in_, &node_out_);
+}
+
+void LiveGraphFactory::LiveMap() {
+  Solve();
+  for (fg::FNodePtr node_ : flowgraph_->Nodes()->GetList()) {
+    in_->Enter(node_, ToTempList(node_in_[node_->Key()]));
+    out_->Enter(node_, ToTempList(node_out_[node_->Key()]));
+  }
 }
 
 void LiveGraphFactory::InterfGraph() {
-  /* STEP1: 将全部temp加入table */
+  IGraphPtr interf_graph = live_graph_.interf_graph;
+
+  /* STEP1: 将全部temp加入冲突图 */
   const std::list<temp::Temp *> precolored_regs =
       reg_manager->Registers()->GetList();
   for (temp::Temp *temp_ : precolored_regs) {
-    INodePtr inode_ptr = live_graph_.interf_graph->NewNode(temp_);
+    INodePtr inode_ptr = interf_graph->NewNode(temp_, true);
     temp_node_map_->Enter(temp_, inode_ptr);
   }
 
-  const std::list<fg::FNodePtr> flowgrapg_nodes =
-      flowgraph_->Nodes()->GetList();
-  for (fg::FNodePtr node_ : flowgrapg_nodes) {
-    assem::Instr *node_ins = node_->NodeInfo();
-    std::list<temp::Temp *> out_list = out_->Look(node_)->GetList();
-    std::list<temp::Temp *> def_list = node_ins->Def()->GetList();
-    for (temp::Temp *temp_ : out_list) {
-      INodePtr inode_ptr = temp_node_map_->Look(temp_);
-      if (!inode_ptr) {
-        INodePtr inode_ptr = live_graph_.interf_graph->NewNode(temp_);
-        temp_node_map_->Enter(temp_, inode_ptr);
-      }
-    }
-    for (temp::Temp *temp_ : def_list) {
-      INodePtr inode_ptr = temp_node_map_->Look(temp_);
-      if (!inode_ptr) {
-        INodePtr inode_ptr = live_graph_.interf_graph->NewNode(temp_);
-        temp_node_map_->Enter(temp_, inode_ptr);
-      }
+  std::vector<INodePtr> index_node(index_temp_.size());
+  for (int i = 0; i < (int)index_temp_.size(); i++) {
+    temp::Temp *temp_ = index_temp_[i];
+    INodePtr inode_ptr = temp_node_map_->Look(temp_);
+    if (!inode_ptr) {
+      inode_ptr = interf_graph->NewNode(temp_);
+      temp_node_map_->Enter(temp_, inode_ptr);
     }
+    index_node[i] = inode_ptr;
   }
 
   /* STEP2: precolored构成完全图 */
   for (temp::Temp *temp_from : precolored_regs)
     for (temp::Temp *temp_to : precolored_regs)
-      if (temp_from != temp_to)
-        live_graph_.interf_graph->AddEdge(temp_node_map_->Look(temp_from),
-                                          temp_node_map_->Look(temp_to));
+      interf_graph->AddEdge(temp_node_map_->Look(temp_from),
+                            temp_node_map_->Look(temp_to));
 
   /* STEP3:
    * For an instruction that defines a variable a, where the live-out variables
@@ -176,50 +335,49 @@ void LiveGraphFactory::InterfGraph() {
    * - If it is a nonmove instruction, add (a, b1), …, (a, bj)
    * - If it is a move instruction a ← c, add (a, b1), …, (a, bj), for any bj
    * that is not the same as c */
+  const std::list<fg::FNodePtr> &flowgrapg_nodes =
+      flowgraph_->Nodes()->GetList();
+  std::unordered_set<uint64_t> move_set;
   for (fg::FNodePtr node_ : flowgrapg_nodes) {
     assem::Instr *node_ins = node_->NodeInfo();
-    const std::list<temp::Temp *> out_list = out_->Look(node_)->GetList();
-    const std::list<temp::Temp *> def_list = node_ins->Def()->GetList();
-    if (typeid(*node_ins) == typeid(assem::MoveInstr)) {
-      const std::list<temp::Temp *> out_dif_use_list =
-          Difference(out_->Look(node_), node_ins->Use())->GetList();
-      const std::list<temp::Temp *> use_list = node_ins->Use()->GetList();
-
-      for (temp::Temp *temp_def : def_list)
-        for (temp::Temp *temp_out_dif_use : out_dif_use_list)
-          if (temp_def != temp_out_dif_use) {
-            INodePtr inode_from = temp_node_map_->Look(temp_def);
-            INodePtr inode_to = temp_node_map_->Look(temp_out_dif_use);
-            if (inode_from->Succ()->Contain(inode_to)) continue;
-            live_graph_.interf_graph->AddEdge(inode_from, inode_to);
-            live_graph_.interf_graph->AddEdge(inode_to, inode_from);
-          }
+    int key = node_->Key();
+    bool is_move = typeid(*node_ins) == typeid(assem::MoveInstr);
 
+    bitset::BitSet live = node_out_[key];
+    if (is_move) live.Subtract(node_use_[key]);
+    node_def_[key].ForEach([&](int def_index) {
+      live.ForEach([&](int out_index) {
+        interf_graph->AddEdge(index_node[def_index], index_node[out_index]);
+      });
+    });
+
+    if (is_move) {
+      const std::list<temp::Temp *> &use_list = node_ins->Use()->GetList();
+      const std::list<temp::Temp *> &def_list = node_ins->Def()->GetList();
       for (temp::Temp *use_temp : use_list)
         for (temp::Temp *def_temp : def_list)
           if (use_temp != def_temp) {
             INodePtr inode_use = temp_node_map_->Look(use_temp);
             INodePtr inode_def = temp_node_map_->Look(def_temp);
-            if (!live_graph_.moves->Contain(inode_use, inode_def) &&
-                !live_graph_.moves->Contain(inode_def, inode_use))
+            /* 无序对(use, def)去重 */
+            uint64_t lo = std::min(inode_use->Key(), inode_def->Key());
+            uint64_t hi = std::max(inode_use->Key(), inode_def->Key());
+            if (move_set.insert(hi << 32 | lo).second)
               live_graph_.moves->Append(inode_use, inode_def);
           }
-    }  // end for instr's is move
-    else
-      for (temp::Temp *temp_def : def_list)
-        for (temp::Temp *temp_out : out_list)
-          if (temp_def != temp_out) {
-            INodePtr inode_from = temp_node_map_->Look(temp_def);
-            INodePtr inode_to = temp_node_map_->Look(temp_out);
-            if (inode_from->Succ()->Contain(inode_to)) continue;
-            live_graph_.interf_graph->AddEdge(inode_from, inode_to);
-            live_graph_.interf_graph->AddEdge(inode_to, inode_from);
-          }  // end for instr's not move
-  }          // end for instr's
+    }
+  }
+}
+
+LiveGraphFactory::~LiveGraphFactory() {
+  delete live_graph_.interf_graph;
+  delete live_graph_.moves;
+  delete temp_node_map_;
 }
 
+/* 寄存器分配只需要bitset形式的结果 */
 void LiveGraphFactory::Liveness() {
-  LiveMap();
+  Solve();
   InterfGraph();
 }
 
@@ -2,11 +2,14 @@
 #define TIGER_LIVENESS_LIVENESS_H_
 
 #include <map>
+#include <unordered_map>
+#include <vector>
 
 #include "tiger/codegen/assem.h"
 #include "tiger/frame/temp.h"
 #include "tiger/frame/x64frame.h"
 #include "tiger/liveness/flowgraph.h"
+#include "tiger/util/bitset.h"
 #include "tiger/util/graph.h"
 
 namespace live {
@@ -15,8 +18,48 @@ using INode = graph::Node<temp::Temp>;
 using INodePtr = graph::Node<temp::Temp> *;
 using INodeList = graph::NodeList<temp::Temp>;
 using INodeListPtr = graph::NodeList<temp::Temp> *;
-using IGraph = graph::Graph<temp::Temp>;
-using IGraphPtr = graph::Graph<temp::Temp> *;
+
+/* 冲突图(Appel/George): adjSet为下三角bit矩阵, 可O(1)判断两点是否冲突;
+ * adjList只为非precolored节点保存, 用于遍历邻居 */
+class IGraph {
+ public:
+  IGraph() = default;
+  IGraph(const IGraph &) = delete;
+  IGraph &operator=(const IGraph &) = delete;
+
+  INodePtr NewNode(temp::Temp *info, bool precolored = false);
+
+  /* 添加无向边(u, v), 已存在的边和自环被忽略 */
+  void AddEdge(INodePtr u, INodePtr v);
+
+  [[nodiscard]] bool Adj(INodePtr u, INodePtr v) const;
+
+  [[nodiscard]] const std::vector<INodePtr> &AdjList(INodePtr n) const {
+    return adj_list_[n->Key()];
+  }
+  /* 包括precolored邻居在内的冲突边数 */
+  [[nodiscard]] int Degree(INodePtr n) const { return degree_[n->Key()]; }
+  [[nodiscard]] bool Precolored(INodePtr n) const {
+    return precolored_[n->Key()];
+  }
+  [[nodiscard]] const std::vector<INodePtr> &Nodes() const { return nodes_; }
+  [[nodiscard]] int EdgeCount() const { return edge_count_; }
+
+ private:
+  graph::Graph<temp::Temp> node_store_;
+  std::vector<INodePtr> nodes_;
+  std::vector<bool> precolored_;
+  std::vector<std::vector<INodePtr>> adj_list_;
+  std::vector<int> degree_;
+  std::vector<uint64_t> adj_set_;
+  int edge_count_ = 0;
+
+  /* (i, j), i > j 在下三角矩阵中的位置 */
+  static uint64_t BitIndex(uint64_t i, uint64_t j) {
+    return i * (i - 1) / 2 + j;
+  }
+};
+using IGraphPtr = IGraph *;
 
 class MoveList {
  public:
@@ -47,27 +90,99 @@ struct LiveGraph {
       : interf_graph(interf_graph), moves(moves) {}
 };
 
+/* 基本块: 流图中只有顺序控制流的一段连续指令 */
+struct LiveBlock {
+  std::vector<fg::FNodePtr> nodes;
+  std::vector<int> succs;
+  std::vector<int> preds;
+  bitset::BitSet use;  // 块内先use后def的temp
+  bitset::BitSet def;
+  bitset::BitSet in;
+  bitset::BitSet out;
+};
+
+/* 流图上以基本块为单位的逆向数据流求解, 集合元素是[0, width)中的稠密编号,
+ * 每条指令的use/def/in/out以FNode::Key()为下标. 帧地址的活跃分析也使用它 */
+class BlockSolver {
+ public:
+  BlockSolver(fg::FGraphPtr flowgraph, int width,
+              const std::vector<bitset::BitSet> &node_use,
+              const std::vector<bitset::BitSet> &node_def);
+  BlockSolver(const BlockSolver &) = delete;
+  BlockSolver &operator=(const BlockSolver &) = delete;
+
+  /* 求解前可以设置块的in作为初值 */
+  std::vector<LiveBlock> &Blocks() { return blocks_; }
+  /* 求解并逆推每条指令的in/out, node_out可以为空 */
+  void Solve(std::vector<bitset::BitSet> *node_in,
+             std::vector<bitset::BitSet> *node_out);
+  /* 处理基本块的次数 */
+  [[nodiscard]] int Iterations() const { return iterations_; }
+
+ private:
+  const std::vector<bitset::BitSet> &node_use_;
+  const std::vector<bitset::BitSet> &node_def_;
+  std::vector<LiveBlock> blocks_;
+  int iterations_ = 0;
+
+  void SolveBlocks();
+};
+
 class LiveGraphFactory {
  public:
-  explicit LiveGraphFactory(fg::FGraphPtr flowgraph)
+  /* prev非空时, 流图由prev的指令经spill重写得到(只插入了load/store),
+   * 用prev的结果作为数据流的初值, 通常一遍即可收敛 */
+  explicit LiveGraphFactory(fg::FGraphPtr flowgraph,
+                            const LiveGraphFactory *prev = nullptr)
       : flowgraph_(flowgraph),
+        prev_(prev),
         live_graph_(new IGraph(), new MoveList()),
         in_(std::make_unique<graph::Table<assem::Instr, temp::TempList>>()),
         out_(std::make_unique<graph::Table<assem::Instr, temp::TempList>>()),
         temp_node_map_(new tab::Table<temp::Temp, INode>()) {}
+  LiveGraphFactory(const LiveGraphFactory &) = delete;
+  LiveGraphFactory &operator=(const LiveGraphFactory &) = delete;
+  ~LiveGraphFactory();
   void Liveness();
   LiveGraph GetLiveGraph() { return live_graph_; }
   tab::Table<temp::Temp, INode> *GetTempNodeMap() { return temp_node_map_; }
   void LiveMap();
+  /* 数据流求解中处理基本块的次数 */
+  int Iterations() const { return solver_ ? solver_->Iterations() : 0; }
+  /* 某条指令处活跃的temp, 须在Liveness()或LiveMap()之后调用 */
+  temp::TempList *LiveIn(fg::FNodePtr node) {
+    return ToTempList(node_in_[node->Key()]);
+  }
+
+  /* 由bit-vector结果生成的in/out视图, key为流图节点 */
   std::unique_ptr<graph::Table<assem::Instr, temp::TempList>> in_;
   std::unique_ptr<graph::Table<assem::Instr, temp::TempList>> out_;
 
  private:
   fg::FGraphPtr flowgraph_;
+  const LiveGraphFactory *prev_;
   LiveGraph live_graph_;
 
   tab::Table<temp::Temp, INode> *temp_node_map_;
 
+  /* temp的稠密编号 */
+  std::unordered_map<temp::Temp *, int> temp_index_;
+  std::vector<temp::Temp *> index_temp_;
+
+  /* 以FNode::Key()为下标的每条指令的use/def/in/out */
+  std::vector<bitset::BitSet> node_use_;
+  std::vector<bitset::BitSet> node_def_;
+  std::vector<bitset::BitSet> node_in_;
+  std::vector<bitset::BitSet> node_out_;
+
+  std::unique_ptr<BlockSolver> solver_;
+
+  void NumberTemps();
+  void SeedBlocks();
+  /* 求解每条指令的in/out bitset, 不生成TempList视图 */
+  void Solve();
+  temp::TempList *ToTempList(const bitset::BitSet &set);
+
   void InterfGraph();
 };
 
@@ -3,9 +3,11 @@
 #include "tiger/frame/x64frame.h"
 #include "tiger/output/logger.h"
 #include "tiger/output/output.h"
+#include "tiger/output/profiler.h"
 #include "tiger/parse/parser.h"
 #include "tiger/semant/semant.h"
 #include "tiger/translate/translate.h"
+#include "tiger/util/arena.h"
 
 frame::RegManager *reg_manager;
 frame::Frags *frags;
@@ -14,23 +16,44 @@ std::vector<std::string> functions_ret_ptr;
 
 int main(int argc, char **argv) {
   std::string_view fname;
+  int jobs = 1;  // -j N: 后端并行生成函数的线程数
+  std::string time_report;  // -ftime-report[=file]: 各阶段的JSON统计
   std::unique_ptr<absyn::AbsynTree> absyn_tree;
   reg_manager = new frame::X64RegManager();
   frags = new frame::Frags();
 
-  if (argc < 2) {
-    fprintf(stderr, "usage: tiger-compiler file.tig\n");
-    exit(1);
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg(argv[i]);
+    if (arg == "-j" && i + 1 < argc)
+      jobs = atoi(argv[++i]);
+    else if (arg.substr(0, 2) == "-j")
+      jobs = atoi(argv[i] + 2);
+    else if (arg == "-ftime-report")
+      prof::Profiler::Get().Enable();
+    else if (arg.substr(0, 14) == "-ftime-report=") {
+      prof::Profiler::Get().Enable();
+      time_report = arg.substr(14);
+    } else
+      fname = arg;
   }
 
-  fname = std::string_view(argv[1]);
+  if (fname.empty() || jobs < 1) {
+    fprintf(stderr,
+            "usage: tiger-compiler [-j N] [-ftime-report[=file]] file.tig\n");
+    exit(1);
+  }
+  if (time_report.empty())
+    time_report = static_cast<std::string>(fname) + ".time.json";
 
   {
+    // AST和translate产生的IR树在整个编译过程中都有效
+    arena::Scope program_scope(arena::Program());
     std::unique_ptr<err::ErrorMsg> errormsg;
 
     {
       // Lab 3: parsing
       TigerLog("-------====Parse=====-----\n");
+      prof::Phase phase("parse");
       Parser parser(fname, std::cerr);
       parser.parse();
       absyn_tree = parser.TransferAbsynTree();
@@ -40,6 +63,7 @@ int main(int argc, char **argv) {
     {
       // Lab 4: semantic analysis
       TigerLog("-------====Semantic analysis=====-----\n");
+      prof::Phase phase("semant");
       sem::ProgSem prog_sem(std::move(absyn_tree), std::move(errormsg));
       prog_sem.SemAnalyze();
       absyn_tree = prog_sem.TransferAbsynTree();
@@ -49,6 +73,7 @@ int main(int argc, char **argv) {
     {
       // Lab 5: escape analysis
       TigerLog("-------====Escape analysis=====-----\n");
+      prof::Phase phase("escape");
       esc::EscFinder esc_finder(std::move(absyn_tree));
       esc_finder.FindEscape();
       absyn_tree = esc_finder.TransferAbsynTree();
@@ -57,6 +82,7 @@ int main(int argc, char **argv) {
     {
       // Lab 5: translate IR tree
       TigerLog("-------====Translate=====-----\n");
+      prof::Phase phase("translate");
       tr::ProgTr prog_tr(std::move(absyn_tree), std::move(errormsg));
       prog_tr.Translate();
       errormsg = prog_tr.TransferErrormsg();
@@ -67,9 +93,19 @@ int main(int argc, char **argv) {
 
   {
     // Output assembly
-    output::AssemGen assem_gen(fname);
+    prof::Phase phase("backend");
+    output::AssemGen assem_gen(fname, jobs);
     assem_gen.GenAssem(true);
   }
 
+  if (prof::Profiler::Get().Enabled()) {
+    prof::Profiler::Get().Report(stderr);
+    FILE *json = fopen(time_report.data(), "w");
+    if (json) {
+      prof::Profiler::Get().WriteJson(json, fname);
+      fclose(json);
+    }
+  }
+
   return 0;
 }
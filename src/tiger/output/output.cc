@@ -1,9 +1,14 @@
 #include "tiger/output/output.h"
 
+#include <atomic>
 #include <cstdio>
+#include <cstdlib>
+#include <thread>
 
 #include "tiger/frame/x64frame.h"
 #include "tiger/output/logger.h"
+#include "tiger/output/profiler.h"
+#include "tiger/util/arena.h"
 
 extern frame::RegManager *reg_manager;
 extern frame::Frags *frags;
@@ -47,21 +52,29 @@ std::vector<int> getEscapePointers(frame::Frame *frame_) {
   return escapePointerOffsets;
 }
 
-/*添加在寄存器分配之后, 产生pointerMap*/
-assem::InstrList *emitPointerMap(assem::InstrList *il, frame::Frame *frame_,
-                                 std::vector<int> escapePointerOffsets,
-                                 temp::Map *color) {
+/* 将一个函数的pointerMap接到全局链表的尾部 */
+void addPointerMaps(const std::vector<gc::PointerMap> &newMaps) {
+  if (globalRoots.size() && newMaps.size())
+    globalRoots.back().nextPointerMapLable = newMaps.front().label;
+  globalRoots.insert(globalRoots.end(), newMaps.begin(), newMaps.end());
+}
+
+/*添加在寄存器分配之后, 产生pointerMap, 放入maps*/
+assem::InstrList *emitPointerMap(
+    assem::InstrList *il, frame::Frame *frame_,
+    std::vector<int> escapePointerOffsets, temp::Map *color,
+    const std::unordered_map<assem::Instr *, temp::TempList *> *labelLive,
+    std::vector<gc::PointerMap> *maps) {
   fg::FlowGraphFactory *flowGraphForGC = new fg::FlowGraphFactory(il);
   flowGraphForGC->AssemFlowGraph();
   fg::FGraphPtr fpForGC = flowGraphForGC->GetFlowGraph();
-  gc::Roots *addressLiveForGC =
-      new gc::Roots(il, frame_, fpForGC, escapePointerOffsets, color);
+  gc::Roots *addressLiveForGC = new gc::Roots(
+      il, frame_, fpForGC, escapePointerOffsets, color, labelLive);
   std::vector<gc::PointerMap> newMaps = addressLiveForGC->GetPointerMaps();
   il = addressLiveForGC->GetInstrList();
-
-  if (globalRoots.size() && newMaps.size())
-    globalRoots.back().nextPointerMapLable = newMaps.front().label;
-  globalRoots.insert(globalRoots.end(), newMaps.begin(), newMaps.end());
+  maps->insert(maps->end(), newMaps.begin(), newMaps.end());
+  delete addressLiveForGC;
+  delete flowGraphForGC;
   return il;
 }
 
@@ -72,7 +85,11 @@ void AssemGen::GenAssem(bool need_ra) {
   // Output proc
   phase = frame::Frag::Proc;
   fprintf(out_, ".text\n");
-  for (auto &&frag : frags->GetList()) frag->OutputAssem(out_, phase, need_ra);
+  if (jobs_ > 1)
+    GenProcsParallel(need_ra);
+  else
+    for (auto &&frag : frags->GetList())
+      frag->OutputAssem(out_, phase, need_ra);
 
   // Output string
   phase = frame::Frag::String;
@@ -83,24 +100,77 @@ void AssemGen::GenAssem(bool need_ra) {
   outPutPointerMap(out_);
 }
 
+/* jobs_个线程各自取下一个函数生成, 输出到该函数的缓冲区;
+   全部完成后按frag顺序拼接文本和pointerMap, 结果与单线程相同 */
+void AssemGen::GenProcsParallel(bool need_ra) {
+  struct ProcOutput {
+    char *text = nullptr;
+    size_t size = 0;
+    std::vector<gc::PointerMap> maps;
+  };
+
+  std::vector<frame::ProcFrag *> procs;
+  for (frame::Frag *frag : frags->GetList())
+    if (auto proc = dynamic_cast<frame::ProcFrag *>(frag))
+      procs.push_back(proc);
+
+  std::vector<ProcOutput> outputs(procs.size());
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < procs.size(); i = next++) {
+      FILE *buf = open_memstream(&outputs[i].text, &outputs[i].size);
+      procs[i]->OutputProc(buf, need_ra, &outputs[i].maps);
+      fclose(buf);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < jobs_; i++) threads.emplace_back(worker);
+  worker();
+  for (std::thread &thread : threads) thread.join();
+
+  for (ProcOutput &output : outputs) {
+    fwrite(output.text, 1, output.size, out_);
+    free(output.text);
+    addPointerMaps(output.maps);
+  }
+}
+
 }  // namespace output
 
 namespace frame {
 
 void ProcFrag::OutputAssem(FILE *out, OutputPhase phase, bool need_ra) const {
+  // When generating proc fragment, do not output string assembly
+  if (phase != Proc) return;
+
+  std::vector<gc::PointerMap> maps;
+  OutputProc(out, need_ra, &maps);
+  output::addPointerMaps(maps);
+}
+
+void ProcFrag::OutputProc(FILE *out, bool need_ra,
+                          std::vector<gc::PointerMap> *maps) const {
+  // 本函数的IR, 指令和图都分配在arena中, 输出完毕后一起释放.
+  // 先于下面的unique_ptr构造, 最后析构
+  arena::Arena arena;
+  arena::Scope scope(&arena);
+  // 后端新建的标号以函数名为前缀, 与其他函数的生成顺序无关
+  temp::LabelFactory::Scope labels(std::string(frame_->lable_->Name()) + ".L");
   std::unique_ptr<canon::Traces> traces;
   std::unique_ptr<cg::AssemInstr> assem_instr;
   std::unique_ptr<ra::Result> allocation;
 
-  // When generating proc fragment, do not output string assembly
-  if (phase != Proc) return;
-
   TigerLog("-------====IR tree=====-----\n");
   TigerLog(body_);
 
+  const std::string name(frame_->lable_->Name());
+  bool profile = prof::Profiler::Get().Enabled();
+
   {
     // Canonicalize
     TigerLog("-------====Canonicalize=====-----\n");
+    prof::Phase phase("canon", name);
+    if (profile) phase.Count(prof::IR_NODES, tree::NodeCount(body_));
     canon::Canon canon(body_);
 
     // Linearize to generate canonical trees
@@ -126,9 +196,11 @@ void ProcFrag::OutputAssem(FILE *out, OutputPhase phase, bool need_ra) const {
   {
     // Lab 5: code generation
     TigerLog("-------====Code generate=====-----\n");
+    prof::Phase phase("codegen", name);
     cg::CodeGen code_gen(frame_, std::move(traces));
     code_gen.Codegen();
     assem_instr = code_gen.TransferAssemInstr();
+    phase.Count(prof::INSTRS, assem_instr->GetInstrList()->GetList().size());
     TigerLog(assem_instr.get(), color);
   }
 
@@ -139,22 +211,44 @@ void ProcFrag::OutputAssem(FILE *out, OutputPhase phase, bool need_ra) const {
   if (need_ra) {
     // Lab 6: register allocation
     TigerLog("----====Register allocate====-----\n");
+    prof::Phase phase("regalloc", name);
     ra::RegAllocator reg_allocator(frame_, std::move(assem_instr));
     reg_allocator.RegAlloc();
+    const std::vector<ra::RoundStat> &rounds = reg_allocator.Rounds();
+    // 节点数和边数取第一轮, 即spill之前的冲突图
+    phase.Count(prof::TEMPS, rounds.front().temps);
+    phase.Count(prof::INTERF_EDGES, rounds.front().edges);
+    phase.Count(prof::SPILL_ROUNDS, rounds.size() - 1);
+    for (const ra::RoundStat &round : rounds)
+      phase.Count(prof::LIVENESS_ITERS, round.iterations);
+    TigerLog("%s: %d rounds\n", frame_->lable_->Name().data(),
+             (int)rounds.size());
+    for (int i = 0; i < (int)rounds.size(); i++)
+      TigerLog("  round %d: %d instrs, %d spills, %d block visits, %.3f ms\n",
+               i + 1, rounds[i].instrs, rounds[i].spills,
+               rounds[i].iterations, rounds[i].ms);
     allocation = reg_allocator.TransferResult();
     il = allocation->il_;
     color =
         temp::Map::LayerMap(reg_manager->getTempMap(), allocation->coloring_);
+    phase.Count(prof::INSTRS, il->GetList().size());
   }
 
-  il = output::emitPointerMap(il, frame_, escapePointerOffsets, color);
+  {
+    prof::Phase phase("pointermap", name);
+    /* 不做寄存器分配时没有callee saves中的指针 */
+    il = output::emitPointerMap(il, frame_, escapePointerOffsets, color,
+                                allocation ? &allocation->label_live_ : nullptr,
+                                maps);
+  }
 
   TigerLog("-------====Output assembly for %s=====-----\n",
            frame_->lable_->Name().data());
 
+  prof::Phase phase("emit", name);
   assem::Proc *proc = frame::procEntryExit3(frame_, il);
 
-  std::string proc_name = frame_->lable_->Name();
+  std::string proc_name(frame_->lable_->Name());
 
   fprintf(out, ".globl %s\n", proc_name.data());
   fprintf(out, ".type %s, @function\n", proc_name.data());
@@ -16,7 +16,7 @@ namespace output {
 class AssemGen {
 public:
   AssemGen() = delete;
-  explicit AssemGen(std::string_view infile) {
+  explicit AssemGen(std::string_view infile, int jobs = 1) : jobs_(jobs) {
     std::string outfile = static_cast<std::string>(infile) + ".s";
     out_ = fopen(outfile.data(), "w");
   }
@@ -32,7 +32,10 @@ public:
   void GenAssem(bool need_ra);
 
 private:
+  void GenProcsParallel(bool need_ra);
+
   FILE *out_; // Instream of source file
+  int jobs_;  // Number of threads generating procs
 };
 
 } // namespace output
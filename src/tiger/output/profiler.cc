@@ -0,0 +1,173 @@
+#include "tiger/output/profiler.h"
+
+#include <algorithm>
+#include <sys/resource.h>
+
+namespace {
+
+constexpr std::array<const char *, prof::COUNTER_NUM> counter_names = {
+    "ir_nodes",     "instrs",       "temps",
+    "interf_edges", "spill_rounds", "liveness_iters"};
+
+long PeakRssKb() {
+  struct rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+double MsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+void PrintJsonString(FILE *out, std::string_view str) {
+  fputc('"', out);
+  for (char c : str) {
+    if (c == '"' || c == '\\')
+      fputc('\\', out);
+    fputc(c, out);
+  }
+  fputc('"', out);
+}
+
+/* 同名阶段的记录(所有函数)按首次出现的顺序合并 */
+std::vector<prof::Record>
+SumByPhase(const std::vector<prof::Record> &records) {
+  std::vector<prof::Record> sums;
+  for (const prof::Record &record : records) {
+    auto it = std::find_if(sums.begin(), sums.end(),
+                           [&](const prof::Record &sum) {
+                             return sum.phase == record.phase;
+                           });
+    if (it == sums.end()) {
+      sums.push_back(record);
+      sums.back().function.clear();
+      continue;
+    }
+    it->ms += record.ms;
+    it->rss_kb += record.rss_kb;
+    for (int i = 0; i < prof::COUNTER_NUM; i++)
+      it->counters[i] += record.counters[i];
+  }
+  return sums;
+}
+
+/* 函数的记录按函数名排序, -j下的完成顺序不影响输出 */
+std::vector<prof::Record>
+FunctionRecords(const std::vector<prof::Record> &records) {
+  std::vector<prof::Record> functions;
+  for (const prof::Record &record : records)
+    if (!record.function.empty())
+      functions.push_back(record);
+  std::stable_sort(functions.begin(), functions.end(),
+                   [](const prof::Record &a, const prof::Record &b) {
+                     return a.function < b.function;
+                   });
+  return functions;
+}
+
+void PrintRow(FILE *out, const prof::Record &record, double total_ms) {
+  fprintf(out, "  %-12s %-20s %10.3f %6.1f%% %8ld", record.phase.data(),
+          record.function.data(), record.ms,
+          total_ms > 0 ? record.ms * 100 / total_ms : 0.0, record.rss_kb);
+  for (long counter : record.counters)
+    fprintf(out, " %14ld", counter);
+  fprintf(out, "\n");
+}
+
+void PrintJsonRecord(FILE *out, const prof::Record &record) {
+  fprintf(out, "{\"phase\": ");
+  PrintJsonString(out, record.phase);
+  if (!record.function.empty()) {
+    fprintf(out, ", \"function\": ");
+    PrintJsonString(out, record.function);
+  }
+  fprintf(out, ", \"ms\": %.3f, \"rss_kb\": %ld", record.ms, record.rss_kb);
+  for (int i = 0; i < prof::COUNTER_NUM; i++)
+    fprintf(out, ", \"%s\": %ld", counter_names[i], record.counters[i]);
+  fprintf(out, "}");
+}
+
+} // namespace
+
+namespace prof {
+
+Profiler &Profiler::Get() {
+  static Profiler profiler;
+  return profiler;
+}
+
+void Profiler::Enable() {
+  enabled_ = true;
+  start_ = std::chrono::steady_clock::now();
+  start_rss_kb_ = PeakRssKb();
+}
+
+void Profiler::Add(Record record) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  records_.push_back(std::move(record));
+}
+
+void Profiler::Report(FILE *out) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  double total_ms = MsSince(start_);
+  fprintf(out,
+          "===------------------------------------------------------===\n");
+  fprintf(out, "                 Tiger compiler time report\n");
+  fprintf(out,
+          "===------------------------------------------------------===\n");
+  fprintf(out, "  Total wall time: %.3f ms, peak RSS: %ld kB (+%ld kB)\n\n",
+          total_ms, PeakRssKb(), PeakRssKb() - start_rss_kb_);
+  fprintf(out, "  %-12s %-20s %10s %7s %8s", "phase", "function", "wall(ms)",
+          "wall%", "rss(kB)");
+  for (const char *name : counter_names)
+    fprintf(out, " %14s", name);
+  fprintf(out, "\n");
+  for (const Record &record : SumByPhase(records_))
+    PrintRow(out, record, total_ms);
+  fprintf(out, "\n");
+  for (const Record &record : FunctionRecords(records_))
+    PrintRow(out, record, total_ms);
+}
+
+void Profiler::WriteJson(FILE *out, std::string_view source) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  fprintf(out, "{\n  \"source\": ");
+  PrintJsonString(out, source);
+  fprintf(out, ",\n  \"total_ms\": %.3f,\n  \"peak_rss_kb\": %ld,\n",
+          MsSince(start_), PeakRssKb());
+  fprintf(out, "  \"phases\": [");
+  std::vector<Record> sums = SumByPhase(records_);
+  for (size_t i = 0; i < sums.size(); i++) {
+    fprintf(out, i ? ",\n    " : "\n    ");
+    PrintJsonRecord(out, sums[i]);
+  }
+  fprintf(out, "\n  ],\n  \"functions\": [");
+  std::vector<Record> functions = FunctionRecords(records_);
+  for (size_t i = 0; i < functions.size(); i++) {
+    fprintf(out, i ? ",\n    " : "\n    ");
+    PrintJsonRecord(out, functions[i]);
+  }
+  fprintf(out, "\n  ]\n}\n");
+}
+
+Phase::Phase(std::string_view phase, std::string_view function)
+    : enabled_(Profiler::Get().Enabled()) {
+  if (!enabled_)
+    return;
+  record_.phase = phase;
+  record_.function = function;
+  start_ = std::chrono::steady_clock::now();
+  start_rss_kb_ = PeakRssKb();
+}
+
+Phase::~Phase() {
+  if (!enabled_)
+    return;
+  record_.ms = MsSince(start_);
+  record_.rss_kb = PeakRssKb() - start_rss_kb_;
+  Profiler::Get().Add(std::move(record_));
+}
+
+} // namespace prof
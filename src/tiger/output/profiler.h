@@ -0,0 +1,84 @@
+#ifndef TIGER_COMPILER_PROFILER_H
+#define TIGER_COMPILER_PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace prof {
+
+enum Counter {
+  IR_NODES,
+  INSTRS,
+  TEMPS,
+  INTERF_EDGES,
+  SPILL_ROUNDS,
+  LIVENESS_ITERS,
+  COUNTER_NUM
+};
+
+/* 一个阶段(对函数后端的阶段, 还有所属函数)的统计 */
+struct Record {
+  std::string phase;
+  std::string function; // Empty for whole-program phases
+  double ms = 0;
+  long rss_kb = 0; // Growth of the peak RSS during the phase
+  std::array<long, COUNTER_NUM> counters{};
+};
+
+/**
+ * Phase timer of the compiler, enabled by -ftime-report. Records come from
+ * Phase objects and may be added from several back-end threads at once.
+ */
+class Profiler {
+public:
+  static Profiler &Get();
+
+  void Enable();
+  [[nodiscard]] bool Enabled() const { return enabled_; }
+
+  void Add(Record record);
+
+  /**
+   * Print one row per phase summed over all functions, followed by one row
+   * per function and phase
+   */
+  void Report(FILE *out) const;
+  void WriteJson(FILE *out, std::string_view source) const;
+
+private:
+  bool enabled_ = false;
+  std::chrono::steady_clock::time_point start_;
+  long start_rss_kb_ = 0;
+  mutable std::mutex mutex_;
+  std::vector<Record> records_;
+};
+
+/**
+ * Time the enclosing scope as one phase. Does nothing unless the profiler
+ * is enabled. Under -j the peak RSS of the process is shared by all threads,
+ * so rss_kb of concurrent function phases is only an approximation.
+ */
+class Phase {
+public:
+  explicit Phase(std::string_view phase, std::string_view function = "");
+  Phase(const Phase &) = delete;
+  Phase &operator=(const Phase &) = delete;
+  ~Phase();
+
+  void Count(Counter counter, long n) { record_.counters[counter] += n; }
+
+private:
+  bool enabled_;
+  Record record_;
+  std::chrono::steady_clock::time_point start_;
+  long start_rss_kb_ = 0;
+};
+
+} // namespace prof
+
+#endif // TIGER_COMPILER_PROFILER_H
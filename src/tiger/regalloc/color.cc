@@ -14,21 +14,50 @@ extern frame::RegManager* reg_manager;
 
 namespace col {
 
+void TagList::Init(int size, int tag_num) {
+  tag_.assign(size, -1);
+  prev_.assign(size, -1);
+  next_.assign(size, -1);
+  head_.assign(tag_num, -1);
+  tail_.assign(tag_num, -1);
+}
+
+void TagList::Move(int i, int tag) {
+  int old_tag = tag_[i];
+  if (old_tag >= 0) {
+    if (prev_[i] >= 0)
+      next_[prev_[i]] = next_[i];
+    else
+      head_[old_tag] = next_[i];
+    if (next_[i] >= 0)
+      prev_[next_[i]] = prev_[i];
+    else
+      tail_[old_tag] = prev_[i];
+  }
+  tag_[i] = tag;
+  prev_[i] = tail_[tag];
+  next_[i] = -1;
+  if (tail_[tag] >= 0)
+    next_[tail_[tag]] = i;
+  else
+    head_[tag] = i;
+  tail_[tag] = i;
+}
+
+/* 主循环中只做状态迁移, 不分配内存 */
 void Color::DoColor() {
   Build();
   MakeWorkList();
   while (true) {
-    if (simplifyWorklist->GetList().size())
+    if (!nodeState.Empty(SIMPLIFY))
       Simplify();
-    else if (worklistMoves->GetList().size())
+    else if (!moveState.Empty(WORKLIST_MOVE))
       Coalesce();
-    else if (freezeWorklist->GetList().size())
+    else if (!nodeState.Empty(FREEZE))
       Freeze();
-    else if (spillWorkList->GetList().size())
+    else if (!nodeState.Empty(SPILL))
       SelectSpill();
-    if (!simplifyWorklist->GetList().size() &&
-        !worklistMoves->GetList().size() && !freezeWorklist->GetList().size() &&
-        !spillWorkList->GetList().size())
+    else
       break;
   }
   AssignColor();
@@ -36,97 +65,110 @@ void Color::DoColor() {
 
 /* 初始化degree, alias, moveList, 添加precolor */
 void Color::Build() {
-  std::list<live::INodePtr> inodes = liveGrapg.interf_graph->Nodes()->GetList();
-  std::list<std::pair<live::INodePtr, live::INodePtr>> move_list =
-      liveGrapg.moves->GetList();
-  for (const live::INodePtr inode : inodes) {
-    degree->Enter(inode, new int(inode->OutDegree()));
-    alias->Enter(inode, inode);
-
-    live::MoveList* inode_moveList = new live::MoveList();
-    for (const std::pair<live::INodePtr, live::INodePtr>& move : move_list)
-      if (move.first == inode || move.second == inode)
-        inode_moveList->Append(move.first, move.second);
-    moveList->Enter(inode, inode_moveList);
+  K = reg_manager->Regnumber();
+  nodes = liveGrapg.interf_graph->Nodes();
+  int node_num = nodes.size();
+
+  nodeState.Init(node_num, NODE_STATE_NUM);
+  degree.resize(node_num);
+  alias.resize(node_num);
+  aliasNext.assign(node_num, -1);
+  aliasTail.resize(node_num);
+  moveList.assign(node_num, std::vector<int>());
+  color.assign(node_num, -1);
+
+  for (temp::Temp* temp_ : reg_manager->Registers()->GetList()) {
+    std::string* reg_color = reg_manager->getTempMap()->Look(temp_);
+    regColors.push_back(reg_color);
+    Coloring->Enter(temp_, reg_color);
   }
 
-  for (temp::Temp* temp_ : reg_manager->Registers()->GetList())
-    Coloring->Enter(temp_, reg_manager->getTempMap()->Look(temp_));
+  for (const live::INodePtr inode : nodes) {
+    int key = inode->Key();
+    degree[key] = liveGrapg.interf_graph->Degree(inode);
+    alias[key] = inode;
+    aliasTail[key] = key;
+    if (Precolored(inode)) {
+      SetState(inode, PRECOLORED);
+      std::string* reg_color =
+          reg_manager->getTempMap()->Look(inode->NodeInfo());
+      for (int c = 0; c < (int)regColors.size(); c++)
+        if (regColors[c] == reg_color) color[key] = c;
+    } else
+      SetState(inode, INITIAL);
+  }
+
+  const std::list<std::pair<live::INodePtr, live::INodePtr>>& move_list =
+      liveGrapg.moves->GetList();
+  moves.assign(move_list.begin(), move_list.end());
+  moveState.Init(moves.size(), MOVE_STATE_NUM);
+  for (int m = 0; m < (int)moves.size(); m++) {
+    moveState.Move(m, WORKLIST_MOVE);
+    moveList[moves[m].first->Key()].push_back(m);
+    moveList[moves[m].second->Key()].push_back(m);
+  }
 }
 
 /* 初始化spillWorkList, freezeWorklist, simplifyWorklist */
 void Color::MakeWorkList() {
-  std::list<live::INodePtr> inodes = liveGrapg.interf_graph->Nodes()->GetList();
-  for (const live::INodePtr inode : inodes) {
+  for (const live::INodePtr inode : nodes) {
     if (Precolored(inode)) continue;
-    if (*(degree->Look(inode)) >= reg_manager->Regnumber())
-      spillWorkList->Append(inode);
+    if (degree[inode->Key()] >= K)
+      SetState(inode, SPILL);
     else if (MoveRelated(inode))
-      freezeWorklist->Append(inode);
+      SetState(inode, FREEZE);
     else
-      simplifyWorklist->Append(inode);
+      SetState(inode, SIMPLIFY);
   }
 }
 
 bool Color::MoveRelated(live::INodePtr inodePtr) {
-  return NodeMoves(inodePtr)->GetList().size() != 0;
-}
-
-/* 返回仍可以Coalesce的moves */
-live::MoveList* Color::NodeMoves(live::INodePtr inode) {
-  live::MoveList* inode_moveList = moveList->Look(inode);
-  return inode_moveList->Intersect(activeMoves->Union(worklistMoves));
+  for (int n = inodePtr->Key(); n >= 0; n = aliasNext[n])
+    for (int m : moveList[n]) {
+      int state = moveState.Tag(m);
+      if (state == ACTIVE_MOVE || state == WORKLIST_MOVE) return true;
+    }
+  return false;
 }
 
 void Color::Simplify() {
-  live::INodePtr inode_to_be_simplified = simplifyWorklist->GetList().back();
-  simplifyWorklist->DeleteNode(inode_to_be_simplified);
-  selectStack.push(inode_to_be_simplified);
-  inStackNode.push_back(inode_to_be_simplified);
-  std::list<live::INodePtr> succ =
-      Adjacent(inode_to_be_simplified->Succ()->GetList());  //在图中的每一个节点
-  for (live::INodePtr inode_succ : succ) DecrementDegree(inode_succ);
+  live::INodePtr inode_to_be_simplified = nodes[nodeState.Back(SIMPLIFY)];
+  SetState(inode_to_be_simplified, SELECT);
+  ForEachAdjacent(inode_to_be_simplified,
+                  [this](live::INodePtr inode_succ) {
+                    DecrementDegree(inode_succ);
+                  });
 }
 
 void Color::DecrementDegree(live::INodePtr inode) {
-  int pre_degree = *(degree->Look(inode));
-  *(degree->Look(inode)) = pre_degree - 1;
-  if (pre_degree == (reg_manager->Regnumber()) && !Precolored(inode)) {
-    live::INodeListPtr adjcent_ = inode->Succ();
-    live::INodeListPtr adjcent_and_inode = new live::INodeList();
-    for (const live::INodePtr inode_ptr : Adjacent(adjcent_->GetList()))
-      adjcent_and_inode->Append(inode_ptr);
-    adjcent_and_inode->Append(inode);
-    EnableMoves(adjcent_and_inode);
-    // 查看activeMoveList中有无可以移除的move
-
-    spillWorkList->DeleteNode(inode);
-    if (MoveRelated(inode))
-      freezeWorklist->Append(inode);
-    else
-      simplifyWorklist->Append(inode);
+  int pre_degree = degree[inode->Key()]--;
+  if (pre_degree == K && !Precolored(inode)) {
+    EnableMoves(inode);
+    ForEachAdjacent(
+        inode, [this](live::INodePtr inode_ptr) { EnableMoves(inode_ptr); });
+
+    /* Combine中AddEdge可能使simplify/freeze中的节点degree达到K,
+      此时节点不在spillWorkList中, 不能重复加入worklist */
+    if (State(inode) == SPILL) {
+      if (MoveRelated(inode))
+        SetState(inode, FREEZE);
+      else
+        SetState(inode, SIMPLIFY);
+    }
   }
 }
 
 /* 由于状态改变, 之前不满足合并条件的move可能已经满足合并条件
   将其移入worklistMoves重新判断 */
-void Color::EnableMoves(live::INodeList* inodes) {
-  std::list<live::INodePtr> inodes_list = inodes->GetList();
-  for (const live::INodePtr& inode_ptr : inodes_list) {
-    std::list<std::pair<live::INodePtr, live::INodePtr>> moveNodes =
-        NodeMoves(inode_ptr)->GetList();
-    for (const std::pair<live::INodePtr, live::INodePtr>& move : moveNodes)
-      if (activeMoves->Contain(move.first, move.second)) {
-        activeMoves->Delete(move.first, move.second);
-        worklistMoves->Append(move.first, move.second);
-      }
-  }
+void Color::EnableMoves(live::INodePtr inode) {
+  ForEachNodeMove(inode, [this](int m) {
+    if (moveState.Tag(m) == ACTIVE_MOVE) moveState.Move(m, WORKLIST_MOVE);
+  });
 }
 
 void Color::Coalesce() {
-  std::pair<live::INodePtr, live::INodePtr> move =
-      worklistMoves->GetList().back();
-  worklistMoves->Delete(move.first, move.second);
+  int m = moveState.Back(WORKLIST_MOVE);
+  const std::pair<live::INodePtr, live::INodePtr>& move = moves[m];
   const live::INodePtr x = GetAlias(move.first);
   const live::INodePtr y = GetAlias(move.second);
   live::INodePtr u = x, v = y;
@@ -135,190 +177,160 @@ void Color::Coalesce() {
     v = x;
   }
   if (u == v) {
-    coalescedMoves->Append(move.first, move.second);
+    moveState.Move(m, COALESCED_MOVE);
     AddWorkList(u);
-  } else if (Precolored(v) || v->Succ()->Contain(u)) {
-    constrainedMoves->Append(move.first, move.second);
+  } else if (Precolored(v) || liveGrapg.interf_graph->Adj(u, v)) {
+    moveState.Move(m, CONSTRAINED_MOVE);
     AddWorkList(u);
     AddWorkList(v);
   } else if ((Precolored(u) && George(u, v)) ||
              (!Precolored(u) && Briggs(u, v))) {
-    coalescedMoves->Append(move.first, move.second);
+    moveState.Move(m, COALESCED_MOVE);
     Combine(u, v);
     AddWorkList(u);
   } else
-    activeMoves->Append(move.first, move.second);
+    moveState.Move(m, ACTIVE_MOVE);
 }
 
-/* assignColor前Color中只有Precolor */
 bool Color::Precolored(live::INodePtr inode) {
-  return Coloring->Look(inode->NodeInfo()) != nullptr;
+  return liveGrapg.interf_graph->Precolored(inode);
 }
 
 void Color::AddWorkList(live::INodePtr inode) {
-  if (!Precolored(inode) && !MoveRelated(inode) &&
-      *(degree->Look(inode)) < reg_manager->Regnumber()) {
-    freezeWorklist->DeleteNode(inode);
-    simplifyWorklist->Append(inode);
-  }
+  if (State(inode) == FREEZE && !MoveRelated(inode) &&
+      degree[inode->Key()] < K)
+    SetState(inode, SIMPLIFY);
 }
 
 bool Color::Briggs(live::INodePtr u, live::INodePtr v) {
   int moreThanK = 0;
-  std::list<live::INodePtr> uSuccUnionvSucc =
-      Adjacent(u->Succ()->Union(v->Succ())->GetList());
-  for (const live::INodePtr& uSucc_inode : uSuccUnionvSucc)
-    if (*(degree->Look(uSucc_inode)) >= reg_manager->Regnumber()) moreThanK++;
-  return moreThanK < reg_manager->Regnumber();
+  ForEachAdjacent(u, [&](live::INodePtr uSucc_inode) {
+    if (degree[uSucc_inode->Key()] >= K) moreThanK++;
+  });
+  /* 同时与u相邻的节点已经计数过 */
+  ForEachAdjacent(v, [&](live::INodePtr vSucc_inode) {
+    if (!liveGrapg.interf_graph->Adj(vSucc_inode, u) &&
+        degree[vSucc_inode->Key()] >= K)
+      moreThanK++;
+  });
+  return moreThanK < K;
 }
 
 bool Color::George(live::INodePtr u, live::INodePtr v) {
-  std::list<live::INodePtr> adjnodes_ = Adjacent(v->Succ()->GetList());
-  for (live::INodePtr inode : adjnodes_) {
-    bool degreeLessThanK = *(degree->Look(inode)) < reg_manager->Regnumber();
+  bool ok = true;
+  ForEachAdjacent(v, [&](live::INodePtr inode) {
+    bool degreeLessThanK = degree[inode->Key()] < K;
     bool precolored = Precolored(inode);
-    bool adjWithu = u->Succ()->Contain(inode);
-    if (!(degreeLessThanK || precolored || adjWithu)) return false;
-  }
-  return true;
+    bool adjWithu = liveGrapg.interf_graph->Adj(inode, u);
+    if (!(degreeLessThanK || precolored || adjWithu)) ok = false;
+  });
+  return ok;
 }
 
 void Color::Combine(live::INodePtr u, live::INodePtr v) {
-  if (freezeWorklist->Contain(v))
-    freezeWorklist->DeleteNode(v);
-  else
-    spillWorkList->DeleteNode(v);
-
-  coalescedNodes->Append(v);
-  alias->Set(v, u);
-  moveList->Set(u, moveList->Look(u)->Union(moveList->Look(v)));
-  live::INodeListPtr temp = new live::INodeList();
-  temp->Append(v);
-  EnableMoves(temp);
-  for (const live::INodePtr& inode_ptr : Adjacent(v->Succ()->GetList())) {
+  SetState(v, COALESCED);
+  alias[v->Key()] = u;
+  EnableMoves(v);
+  /* moveList[u] = moveList[u] ∪ moveList[v] */
+  aliasNext[aliasTail[u->Key()]] = v->Key();
+  aliasTail[u->Key()] = aliasTail[v->Key()];
+
+  ForEachAdjacent(v, [&](live::INodePtr inode_ptr) {
     AddEdge(inode_ptr, u);
     DecrementDegree(inode_ptr);
-  }
-  if (*(degree->Look(u)) >= reg_manager->Regnumber() &&
-      freezeWorklist->Contain(u)) {
-    spillWorkList->Append(u);
-    freezeWorklist->DeleteNode(u);
-  }
+  });
+  if (degree[u->Key()] >= K && State(u) == FREEZE) SetState(u, SPILL);
 }
 
 live::INodePtr Color::GetAlias(live::INodePtr inode_ptr) {
-  if (coalescedNodes->Contain(inode_ptr))
-    return GetAlias(alias->Look(inode_ptr));
+  while (State(inode_ptr) == COALESCED) inode_ptr = alias[inode_ptr->Key()];
   return inode_ptr;
 }
 
 void Color::AddEdge(live::INodePtr u, live::INodePtr v) {
-  if (!u->Succ()->Contain(v) && u != v) {
-    if (!Precolored(u)) {
-      liveGrapg.interf_graph->AddEdge(u, v);
-      *(degree->Look(u)) = *(degree->Look(u)) + 1;
-    }
-    if (!Precolored(v)) {
-      liveGrapg.interf_graph->AddEdge(v, u);
-      *(degree->Look(v)) = *(degree->Look(v)) + 1;
-    }
+  if (!liveGrapg.interf_graph->Adj(u, v) && u != v) {
+    liveGrapg.interf_graph->AddEdge(u, v);
+    if (!Precolored(u)) degree[u->Key()]++;
+    if (!Precolored(v)) degree[v->Key()]++;
   }
 }
 
 void Color::Freeze() {
-  live::INodePtr inode = freezeWorklist->GetList().back();
-  freezeWorklist->DeleteNode(inode);
-  simplifyWorklist->Append(inode);
+  live::INodePtr inode = nodes[nodeState.Back(FREEZE)];
+  SetState(inode, SIMPLIFY);
   FreezeMoves(inode);
 }
 
 void Color::FreezeMoves(live::INodePtr inode_u) {
-  std::list<std::pair<live::INodePtr, live::INodePtr>> nodeMoves_u =
-      NodeMoves(inode_u)->GetList();
-  for (std::pair<live::INodePtr, live::INodePtr>& move_m : nodeMoves_u) {
-    const live::INodePtr inode_x = move_m.first;
-    const live::INodePtr inode_y = move_m.second;
+  ForEachNodeMove(inode_u, [&](int m) {
+    const live::INodePtr inode_x = moves[m].first;
+    const live::INodePtr inode_y = moves[m].second;
     live::INodePtr inode_v = nullptr;
     if (GetAlias(inode_y) == GetAlias(inode_u))
       inode_v = GetAlias(inode_x);
     else
       inode_v = GetAlias(inode_y);
-    activeMoves->Delete(inode_x, inode_y);
-
-    frozenMoves->Append(inode_x, inode_y);
+    moveState.Move(m, FROZEN_MOVE);
 
-    if (!NodeMoves(inode_v)->GetList().size() &&
-        *(degree->Look(inode_v)) < reg_manager->Regnumber()) {
-      freezeWorklist->DeleteNode(inode_v);
-      simplifyWorklist->Append(inode_v);
-    }
-  }
+    /* inode_v可能是precolored或已经在selectStack中 */
+    if (State(inode_v) == FREEZE && !MoveRelated(inode_v) &&
+        degree[inode_v->Key()] < K)
+      SetState(inode_v, SIMPLIFY);
+  });
 }
 
 void Color::SelectSpill() {
-  std::list<live::INodePtr> inodes = spillWorkList->GetList();
   live::INodePtr inode;
   int bigistSucc = 0;
-  for (live::INodePtr spillWorkListNode : inodes)
-    if (spillWorkListNode->Succ()->GetList().size() > bigistSucc) {
-      inode = spillWorkListNode;
-      bigistSucc = spillWorkListNode->Succ()->GetList().size();
+  for (int n = nodeState.Front(SPILL); n >= 0; n = nodeState.Next(n)) {
+    int succ = liveGrapg.interf_graph->AdjList(nodes[n]).size();
+    if (succ > bigistSucc) {
+      inode = nodes[n];
+      bigistSucc = succ;
     }
-  spillWorkList->DeleteNode(inode);
-  simplifyWorklist->Append(inode);
+  }
+  SetState(inode, SIMPLIFY);
   FreezeMoves(inode);
 }
 
 void Color::AssignColor() {
-  while (!selectStack.empty()) {
-    live::INodePtr inode_tocolor = selectStack.top();
-    selectStack.pop();
-    std::list<temp::Temp*> regs = reg_manager->Registers()->GetList();
-    std::list<std::string*> okColor;
-    for (temp::Temp* oktemp : regs)
-      okColor.push_back(reg_manager->getTempMap()->Look(oktemp));
-
-    std::list<live::INodePtr> adj = inode_tocolor->Succ()->GetList();
+  std::vector<bool> okColor(regColors.size());
+  while (!nodeState.Empty(SELECT)) {
+    live::INodePtr inode_tocolor = nodes[nodeState.Back(SELECT)];
+    okColor.assign(regColors.size(), true);
+
+    const std::vector<live::INodePtr>& adj =
+        liveGrapg.interf_graph->AdjList(inode_tocolor);
     for (const live::INodePtr& inode_w : adj) {
-      std::string* neibor_color = Coloring->Look(GetAlias(inode_w)->NodeInfo());
-      if (neibor_color) okColor.remove(neibor_color);
+      int neibor_color = color[GetAlias(inode_w)->Key()];
+      if (neibor_color >= 0) okColor[neibor_color] = false;
     }
 
-    if (okColor.empty())
-      spillNodes->Append(inode_tocolor);
-    else
-      Coloring->Enter(inode_tocolor->NodeInfo(), okColor.front());
+    int c = 0;
+    while (c < (int)okColor.size() && !okColor[c]) c++;
+    if (c == (int)okColor.size())
+      SetState(inode_tocolor, SPILLED);
+    else {
+      SetState(inode_tocolor, COLORED);
+      color[inode_tocolor->Key()] = c;
+      Coloring->Enter(inode_tocolor->NodeInfo(), regColors[c]);
+    }
   }
   /* RSP */
   Coloring->Enter(reg_manager->StackPointer(), new std::string("%rsp"));
   /* 为Coalesed的寄存器分配 */
-  std::list<live::INodePtr> coalescedNodes_list = coalescedNodes->GetList();
-  for (live::INodePtr coalescedNode : coalescedNodes_list)
-    Coloring->Enter(coalescedNode->NodeInfo(),
-                    Coloring->Look(GetAlias(coalescedNode)->NodeInfo()));
+  for (int n = nodeState.Front(COALESCED); n >= 0; n = nodeState.Next(n))
+    Coloring->Enter(nodes[n]->NodeInfo(),
+                    Coloring->Look(GetAlias(nodes[n])->NodeInfo()));
 }
 
 Result Color::TransferResult() {
   Result result;
-  result.spills = spillNodes;
+  result.spills = new live::INodeList();
+  for (int n = nodeState.Front(SPILLED); n >= 0; n = nodeState.Next(n))
+    result.spills->Append(nodes[n]);
   result.coloring = Coloring;
   return result;
 }
 
-/* 过滤出目前仍在图中(没有symplify和coalesce)的临近节点 */
-std::list<live::INodePtr> Color::Adjacent(std::list<live::INodePtr> origon) {
-  std::list<live::INodePtr> ret;
-  std::list<live::INodePtr> coalesced_list = coalescedNodes->GetList();
-  for (auto node : origon) {
-    if (std::find(coalesced_list.begin(), coalesced_list.end(), node) !=
-        coalesced_list.end())
-      continue;
-    if (std::find(inStackNode.begin(), inStackNode.end(), node) !=
-        inStackNode.end())
-      continue;
-    ret.push_back(node);
-  }
-  return ret;
-}
-
 }  // namespace col
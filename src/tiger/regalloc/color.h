@@ -1,7 +1,8 @@
 #ifndef TIGER_COMPILER_COLOR_H
 #define TIGER_COMPILER_COLOR_H
 
-#include <stack>
+#include <string>
+#include <vector>
 
 #include "tiger/codegen/assem.h"
 #include "tiger/frame/temp.h"
@@ -17,76 +18,107 @@ struct Result {
   live::INodeListPtr spills;
 };
 
+/* 元素(节点或move的下标)各带一个tag, tag相同的元素串成一条双向链表.
+  状态迁移, 成员判断, 取表头表尾都是O(1), Init之后不再分配内存 */
+class TagList {
+ public:
+  void Init(int size, int tag_num);
+  [[nodiscard]] int Tag(int i) const { return tag_[i]; }
+  /* 从原链表摘下, 追加到tag链表尾部 */
+  void Move(int i, int tag);
+  [[nodiscard]] bool Empty(int tag) const { return head_[tag] < 0; }
+  [[nodiscard]] int Front(int tag) const { return head_[tag]; }
+  [[nodiscard]] int Back(int tag) const { return tail_[tag]; }
+  [[nodiscard]] int Next(int i) const { return next_[i]; }
+
+ private:
+  std::vector<int> tag_;
+  std::vector<int> prev_;
+  std::vector<int> next_;
+  std::vector<int> head_;
+  std::vector<int> tail_;
+};
+
 class Color {
  public:
   Color(live::LiveGraph liveGrapg_)
-      : liveGrapg(liveGrapg_),
-        worklistMoves(liveGrapg_.moves),
-        Coloring(new temp::Map()),
-        spills(new live::INodeList()),
-        alias(new tab::Table<live::INode, live::INode>()),
-        degree(new tab::Table<live::INode, int>()),
-        moveList(new tab::Table<live::INode, live::MoveList>()),
-        spillWorkList(new live::INodeList()),
-        simplifyWorklist(new live::INodeList()),
-        freezeWorklist(new live::INodeList()),
-        spillNodes(new live::INodeList()),
-        activeMoves(new live::MoveList()),
-        coalescedNodes(new live::INodeList()),
-        coalescedMoves(new live::MoveList()),
-        constrainedMoves(new live::MoveList()),
-        frozenMoves(new live::MoveList()) {}
+      : liveGrapg(liveGrapg_), Coloring(new temp::Map()) {}
   void DoColor();
   Result TransferResult();
 
  private:
+  /* 节点所在的集合, 每个节点同一时刻只属于一个 */
+  enum NodeState {
+    PRECOLORED,
+    INITIAL,
+    /* low-degree non-move-related nodes */
+    SIMPLIFY,
+    /* low-degree move-related nodes */
+    FREEZE,
+    /* high-degree nodes */
+    SPILL,
+    /* Nodes marked for spilling */
+    SPILLED,
+    COALESCED,
+    COLORED,
+    /* 已从图中删除, 在selectStack中, 链表尾为栈顶 */
+    SELECT,
+    NODE_STATE_NUM
+  };
+
+  /* move所在的集合 */
+  enum MoveState {
+    /* Moves enabled for coalescing */
+    WORKLIST_MOVE,
+    /* Moves not yet ready for coalescing */
+    ACTIVE_MOVE,
+    /* Moves has been coalesced */
+    COALESCED_MOVE,
+    /* Moves whose source and target intefere */
+    CONSTRAINED_MOVE,
+    /* Moves that will no longer been considered for coalescing */
+    FROZEN_MOVE,
+    MOVE_STATE_NUM
+  };
+
   live::LiveGraph liveGrapg;
 
   temp::Map* Coloring;
 
-  live::INodeList* spills;
-
-  tab::Table<live::INode, live::INode>* alias;
-
-  tab::Table<live::INode, int>* degree;
+  int K;
 
-  tab::Table<live::INode, live::MoveList>* moveList;
+  /* 以下均以INode的Key()为下标 */
+  std::vector<live::INodePtr> nodes;
 
-  /* high-degree nodes */
-  live::INodeListPtr spillWorkList;
+  TagList nodeState;
 
-  /* low-degree non-move-related nodes */
-  live::INodeListPtr simplifyWorklist;
+  std::vector<int> degree;
 
-  /* low-degree move-related nodes */
-  live::INodeListPtr freezeWorklist;
+  std::vector<live::INodePtr> alias;
 
-  /* Nodes marked for spilling */
-  live::INodeListPtr spillNodes;
+  /* 合并到同一节点的节点串成链表, 其moveList之并即合并后节点的moveList */
+  std::vector<int> aliasNext;
 
-  live::INodeListPtr coalescedNodes;
+  std::vector<int> aliasTail;
 
-  /* Moves not yet ready for coalescing */
-  live::MoveList* activeMoves;
+  /* 与节点相关的move下标 */
+  std::vector<std::vector<int>> moveList;
 
-  /* Moves enabled for coalescing */
-  live::MoveList* worklistMoves;
+  /* 颜色下标, -1为未着色 */
+  std::vector<int> color;
 
-  /* Moves has been coalesced */
-  live::MoveList* coalescedMoves;
+  std::vector<std::pair<live::INodePtr, live::INodePtr>> moves;
 
-  /* Moves whose source and target intefere */
-  live::MoveList* constrainedMoves;
+  TagList moveState;
 
-  /* Moves that will no longer been considered for coalescing */
-  live::MoveList* frozenMoves;
+  /* Registers()顺序的颜色, AssignColor按此顺序选择 */
+  std::vector<std::string*> regColors;
 
-  /* Containing temporaries removed from the graph */
-  std::stack<live::INodePtr> selectStack;
+  /* 对仍在图中(没有simplify和coalesce)的临近节点调用f */
+  template <typename F> void ForEachAdjacent(live::INodePtr inode, F f);
 
-  std::vector<live::INodePtr> inStackNode;
-  
-  std::list<live::INodePtr> Adjacent(std::list<live::INodePtr> origon);
+  /* 对仍可以Coalesce的moves调用f */
+  template <typename F> void ForEachNodeMove(live::INodePtr inode, F f);
 
   void Build();
 
@@ -104,13 +136,11 @@ class Color {
 
   bool MoveRelated(live::INodePtr inodePtr);
 
-  live::MoveList* NodeMoves(live::INodePtr inode);
-
   void DecrementDegree(live::INodePtr inode);
 
   void AddWorkList(live::INodePtr inode);
 
-  void EnableMoves(live::INodeList* inodes);
+  void EnableMoves(live::INodePtr inode);
 
   bool Precolored(live::INodePtr inode);
 
@@ -126,7 +156,33 @@ class Color {
 
   void FreezeMoves(live::INodePtr inode);
 
+  [[nodiscard]] int State(live::INodePtr inode) const {
+    return nodeState.Tag(inode->Key());
+  }
+  void SetState(live::INodePtr inode, NodeState state) {
+    nodeState.Move(inode->Key(), state);
+  }
 };
+
+template <typename F> void Color::ForEachAdjacent(live::INodePtr inode, F f) {
+  const std::vector<live::INodePtr>& adj =
+      liveGrapg.interf_graph->AdjList(inode);
+  /* Combine中AddEdge可能向其他节点的邻接表追加, 按下标遍历 */
+  for (size_t i = 0; i < adj.size(); i++) {
+    live::INodePtr node = adj[i];
+    int state = State(node);
+    if (state == SELECT || state == COALESCED) continue;
+    f(node);
+  }
+}
+
+template <typename F> void Color::ForEachNodeMove(live::INodePtr inode, F f) {
+  for (int n = inode->Key(); n >= 0; n = aliasNext[n])
+    for (int m : moveList[n]) {
+      int state = moveState.Tag(m);
+      if (state == ACTIVE_MOVE || state == WORKLIST_MOVE) f(m);
+    }
+}
 }  // namespace col
 
 #endif  // TIGER_COMPILER_COLOR_H
@@ -1,5 +1,6 @@
 #include "tiger/regalloc/regalloc.h"
 
+#include <chrono>
 #include <iostream>
 
 #include "tiger/output/logger.h"
@@ -8,9 +9,9 @@ extern frame::RegManager* reg_manager;
 
 namespace ra {
 void printGraph(live::LiveGraph liveGrapg_) {
-  for (auto node : liveGrapg_.interf_graph->Nodes()->GetList()) {
+  for (auto node : liveGrapg_.interf_graph->Nodes()) {
     std::cout << "t" << node->NodeInfo()->Int() << "'s succ:\n";
-    for (auto succ : node->Succ()->GetList())
+    for (auto succ : liveGrapg_.interf_graph->AdjList(node))
       std::cout << "t" << succ->NodeInfo()->Int() << ",";
     std::cout << "\n";
   }
@@ -19,27 +20,61 @@ void printGraph(live::LiveGraph liveGrapg_) {
               << *(reg_manager->getTempMap()->Look(temp)) << std::endl;
   }
 }
+/* 每轮重建流图, 活跃分析以上一轮的结果为初值增量求解 */
 void RegAllocator::RegAlloc() {
+  fg::FlowGraphFactory* prevFlowGraphFac = nullptr;
+  live::LiveGraphFactory* prevLiveGraphFac = nullptr;
   while (true) {
+    auto round_start = std::chrono::steady_clock::now();
     fg::FlowGraphFactory* flowGraphFacPtr = new fg::FlowGraphFactory(il_);
     flowGraphFacPtr->AssemFlowGraph();
     fg::FGraphPtr fgraph = flowGraphFacPtr->GetFlowGraph();
 
     live::LiveGraphFactory* liveGraphFacPtr =
-        new live::LiveGraphFactory(fgraph);
+        new live::LiveGraphFactory(fgraph, prevLiveGraphFac);
     liveGraphFacPtr->Liveness();
     live::LiveGraph liveGrapg_ = liveGraphFacPtr->GetLiveGraph();
+    delete prevLiveGraphFac;
+    delete prevFlowGraphFac;
+
+    RoundStat stat;
+    /* 合并时会向冲突图加边, 在着色之前统计 */
+    stat.temps = liveGrapg_.interf_graph->Nodes().size();
+    stat.edges = liveGrapg_.interf_graph->EdgeCount();
 
     col::Color* color_ = new col::Color(liveGrapg_);
     color_->DoColor();
     col::Result colorResult = color_->TransferResult();
+    delete color_;
+
+    stat.instrs = il_->GetList().size();
+    stat.spills = colorResult.spills->GetList().size();
+    stat.iterations = liveGraphFacPtr->Iterations();
 
-    if (colorResult.spills->GetList().size())
+    /* spill重写之后旧的流图和活跃分析结果留作下一轮的初值 */
+    if (stat.spills) {
       rewriteProc(colorResult.spills);
-    else {
+      delete colorResult.coloring;
+    }
+    delete colorResult.spills;
+    stat.ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - round_start)
+                  .count();
+    rounds_.push_back(stat);
+
+    if (!stat.spills) {
       coloring_ = colorResult.coloring;
+      /* 删除合并的move之前记录, 之后再对指令做活跃分析会把合并的temp
+       * 的活跃范围错误地延伸 */
+      for (fg::FNodePtr node_ : fgraph->Nodes()->GetList())
+        if (typeid(*node_->NodeInfo()) == typeid(assem::LabelInstr))
+          label_live_[node_->NodeInfo()] = liveGraphFacPtr->LiveIn(node_);
+      delete liveGraphFacPtr;
+      delete flowGraphFacPtr;
       break;
     }
+    prevFlowGraphFac = flowGraphFacPtr;
+    prevLiveGraphFac = liveGraphFacPtr;
   }
   removeUnecessaryMoves();
 }
@@ -83,9 +118,9 @@ void RegAllocator::rewriteProc(live::INodeListPtr inodeListPtr) {
 
         //若需要替换
         if (replace) {
-          std::string ass_load = "movq (" + frame_->lable_->Name() +
-                                 "_framesize-" + std::to_string(-offset_) +
-                                 ")(%rsp), `d0";  // get framepointer
+          std::string ass_load =
+              "movq (" + std::string(frame_->lable_->Name()) + "_framesize-" +
+              std::to_string(-offset_) + ")(%rsp), `d0";  // get framepointer
           assem::OperInstr* ins_load = new assem::OperInstr(
               ass_load, new temp::TempList({new_temp_reg}), nullptr, nullptr);
           iter_ = ins_list.insert(iter_, ins_load);  // iter指向load
@@ -102,9 +137,9 @@ void RegAllocator::rewriteProc(live::INodeListPtr inodeListPtr) {
                                                      new_temp_reg);
         //若需要替换
         if (replace) {
-          std::string ass_store = "movq `s0, (" + frame_->lable_->Name() +
-                                  "_framesize-" + std::to_string(-offset_) +
-                                  ")(%rsp)";  // store
+          std::string ass_store =
+              "movq `s0, (" + std::string(frame_->lable_->Name()) +
+              "_framesize-" + std::to_string(-offset_) + ")(%rsp)";  // store
           assem::OperInstr* ins_store = new assem::OperInstr(
               ass_store, nullptr, new temp::TempList({new_temp_reg}), nullptr);
           iter_++;  // iter指向下一条指令
@@ -1,6 +1,9 @@
 #ifndef TIGER_REGALLOC_REGALLOC_H_
 #define TIGER_REGALLOC_REGALLOC_H_
 
+#include <unordered_map>
+#include <vector>
+
 #include "tiger/codegen/assem.h"
 #include "tiger/codegen/codegen.h"
 #include "tiger/frame/frame.h"
@@ -15,6 +18,8 @@ class Result {
  public:
   temp::Map *coloring_;
   assem::InstrList *il_;
+  /* 最后一轮活跃分析中每个label处活跃的temp, 供GC生成pointer map */
+  std::unordered_map<assem::Instr *, temp::TempList *> label_live_;
   Result() : coloring_(nullptr), il_(nullptr) {}
   Result(temp::Map *coloring, assem::InstrList *il)
       : coloring_(coloring), il_(il) {}
@@ -25,6 +30,16 @@ class Result {
   ~Result() {}
 };
 
+/* 一轮 着色-spill重写 的统计 */
+struct RoundStat {
+  int instrs;      // 本轮的指令数
+  int spills;      // 本轮spill的temp数
+  int iterations;  // 活跃分析处理基本块的次数
+  int temps;       // 冲突图的节点数
+  int edges;       // 冲突图的边数
+  double ms;       // 本轮耗时
+};
+
 class RegAllocator {
  public:
   RegAllocator(frame::Frame *frame__,
@@ -34,13 +49,19 @@ class RegAllocator {
   std::unique_ptr<ra::Result> TransferResult() {
     std::unique_ptr<ra::Result> result =
         std::make_unique<ra::Result>(coloring_, il_);
+    result->label_live_ = std::move(label_live_);
     return std::move(result);
   }
+  [[nodiscard]] const std::vector<RoundStat> &Rounds() const {
+    return rounds_;
+  }
 
  private:
   frame::Frame *frame_;
   temp::Map *coloring_;
   assem::InstrList *il_;
+  std::unordered_map<assem::Instr *, temp::TempList *> label_live_;
+  std::vector<RoundStat> rounds_;
   /* 根据color的spillNodes重写Proc */
   void rewriteProc(live::INodeListPtr inodeListPtr);
   void removeUnecessaryMoves();
@@ -0,0 +1,23 @@
+#ifndef TIGER_RUNTIME_GC_ALLOC_H
+#define TIGER_RUNTIME_GC_ALLOC_H
+
+#include <stdint.h>
+
+namespace gc {
+
+/* 内联分配的协议, 编译器和运行时共用.
+ * 生成的代码在[tiger_alloc_ptr, tiger_alloc_limit)中bump分配record:
+ *   object = tiger_alloc_ptr; end = object + INLINE_HEADER_SIZE + 字段大小
+ *   if (end > tiger_alloc_limit) 调用alloc_record
+ *   tiger_alloc_ptr = end; 头部字 = &<type>_HEADER_DESCRIPTOR; 字段清零
+ * 得到的record指针为object + INLINE_HEADER_SIZE. 头部字指向的descriptor
+ * 比普通descriptor多一个表示头部的'0', 运行时据此登记这些record.
+ * 不带GC的runtime.c把两个指针都定义为0, 总是走alloc_record */
+constexpr const char *ALLOC_PTR_SYMBOL = "tiger_alloc_ptr";
+constexpr const char *ALLOC_LIMIT_SYMBOL = "tiger_alloc_limit";
+constexpr const char *HEADER_DESCRIPTOR_SUFFIX = "_HEADER_DESCRIPTOR";
+constexpr int INLINE_HEADER_SIZE = 8;
+
+}  // namespace gc
+
+#endif  // TIGER_RUNTIME_GC_ALLOC_H
@@ -0,0 +1,102 @@
+#ifndef TIGER_RUNTIME_GC_ALLOC_FILL_H
+#define TIGER_RUNTIME_GC_ALLOC_FILL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace gc {
+
+/* init_array的填充: 用value填充dst开始的count个字(dst按8字节对齐).
+ * 第一次调用时按cpuid选择AVX2或SSE2的版本, TIGER_FILL=scalar|sse2|avx2
+ * 可以指定版本, 用于对比. 超过NONTEMPORAL_WORDS的数组用non-temporal store,
+ * 不把马上就要被覆盖的cache行换出 */
+constexpr uint64_t FILL_SIMD_MIN_WORDS = 16;
+constexpr uint64_t NONTEMPORAL_WORDS = 1 << 18;  // 2MB
+
+using FillKernel = void (*)(uint64_t *dst, uint64_t value, uint64_t count);
+
+static void FillScalar(uint64_t *dst, uint64_t value, uint64_t count) {
+  for (uint64_t i = 0; i < count; i++) dst[i] = value;
+}
+
+#if defined(__x86_64__)
+static void FillSSE2(uint64_t *dst, uint64_t value, uint64_t count) {
+  uint64_t *end = dst + count;
+  if ((uintptr_t)dst & 15) *dst++ = value;  // 对齐到16字节
+  __m128i v = _mm_set1_epi64x(value);
+  bool stream = count >= NONTEMPORAL_WORDS;
+  for (; dst + 8 <= end; dst += 8) {
+    __m128i *p = (__m128i *)dst;
+    if (stream) {
+      _mm_stream_si128(p, v);
+      _mm_stream_si128(p + 1, v);
+      _mm_stream_si128(p + 2, v);
+      _mm_stream_si128(p + 3, v);
+    } else {
+      _mm_store_si128(p, v);
+      _mm_store_si128(p + 1, v);
+      _mm_store_si128(p + 2, v);
+      _mm_store_si128(p + 3, v);
+    }
+  }
+  if (stream) _mm_sfence();
+  for (; dst < end; dst++) *dst = value;
+}
+
+__attribute__((target("avx2"))) static void FillAVX2(uint64_t *dst,
+                                                     uint64_t value,
+                                                     uint64_t count) {
+  uint64_t *end = dst + count;
+  while ((uintptr_t)dst & 31) *dst++ = value;  // 对齐到32字节, count >= 4
+  __m256i v = _mm256_set1_epi64x(value);
+  bool stream = count >= NONTEMPORAL_WORDS;
+  for (; dst + 16 <= end; dst += 16) {
+    __m256i *p = (__m256i *)dst;
+    if (stream) {
+      _mm256_stream_si256(p, v);
+      _mm256_stream_si256(p + 1, v);
+      _mm256_stream_si256(p + 2, v);
+      _mm256_stream_si256(p + 3, v);
+    } else {
+      _mm256_store_si256(p, v);
+      _mm256_store_si256(p + 1, v);
+      _mm256_store_si256(p + 2, v);
+      _mm256_store_si256(p + 3, v);
+    }
+  }
+  if (stream) _mm_sfence();
+  for (; dst + 4 <= end; dst += 4) _mm256_store_si256((__m256i *)dst, v);
+  for (; dst < end; dst++) *dst = value;
+}
+#endif
+
+static FillKernel SelectFillKernel() {
+  const char *name = getenv("TIGER_FILL");
+  if (name && !strcmp(name, "scalar")) return FillScalar;
+#if defined(__x86_64__)
+  if (name && !strcmp(name, "sse2")) return FillSSE2;
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return FillAVX2;
+  return FillSSE2;
+#else
+  return FillScalar;
+#endif
+}
+
+inline void FillWords(uint64_t *dst, uint64_t value, uint64_t count) {
+  if (count < FILL_SIMD_MIN_WORDS) {
+    FillScalar(dst, value, count);
+    return;
+  }
+  static const FillKernel kernel = SelectFillKernel();
+  kernel(dst, value, count);
+}
+
+}  // namespace gc
+
+#endif  // TIGER_RUNTIME_GC_ALLOC_FILL_H
@@ -0,0 +1,20 @@
+#ifndef TIGER_RUNTIME_GC_BARRIER_H
+#define TIGER_RUNTIME_GC_BARRIER_H
+
+#include <stdint.h>
+
+namespace gc {
+
+/* 写屏障的card table, 编译器和运行时共用.
+ * 向record/数组写入后, 生成的代码执行
+ *   tiger_card_table[(address >> CARD_SHIFT) & (CARD_TABLE_SIZE - 1)] = 1
+ * 表按下标取模, 超过CARD_TABLE_SIZE个card的heap只会多扫描一些card.
+ * 不带GC的runtime.c也定义了同名的表, 大小须与这里一致 */
+constexpr int CARD_SHIFT = 9;
+constexpr uint64_t CARD_SIZE = 1 << CARD_SHIFT;
+constexpr uint64_t CARD_TABLE_SIZE = 1 << 16;
+constexpr const char *CARD_TABLE_SYMBOL = "tiger_card_table";
+
+}  // namespace gc
+
+#endif  // TIGER_RUNTIME_GC_BARRIER_H
@@ -1,233 +1,933 @@
 #include "heap.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 namespace gc {
 
-inline void TigerHeap::SortIntervalBySize() {
-  std::sort(free_intervals.begin(), free_intervals.end(),
-            TigerHeap::compareIntervalBySize);
-}
-
-inline void TigerHeap::SortIntervalByStartAddr() {
-  std::sort(free_intervals.begin(), free_intervals.end(),
-            TigerHeap::compareIntervalByStartAddr);
-}
-
-/* 合并相邻的空闲区间 */
-void TigerHeap::Coalesce() {
-  SortIntervalByStartAddr();
-  auto iter = free_intervals.begin();
-  while ((iter + 1) != free_intervals.end()) {
-    auto iter_next = iter;
-    iter_next++;
-    if ((uint64_t)(*iter).intervalEnd == (uint64_t)(*iter_next).intervalStart) {
-      freeIntervalInfo newIterval;
-      newIterval.intervalStart = (*iter).intervalStart;
-      newIterval.intervalEnd = (*iter_next).intervalEnd;
-      newIterval.intervalSize =
-          (*iter).intervalSize + (*iter_next).intervalSize;
-
-      iter = free_intervals.erase(iter);  // iter指向iter_next
-      iter = free_intervals.erase(iter);  // iter指向下一个item
-      iter = free_intervals.insert(iter, newIterval);  // iter指向newInterval
-      continue;
+static inline uint64_t AlignSize(uint64_t size) {
+  // 至少一个字, 空闲链表的next指针存放在块中
+  if (size == 0) return TigerHeap::WORD_SIZE;
+  return (size + TigerHeap::WORD_SIZE - 1) & ~(TigerHeap::WORD_SIZE - 1);
+}
+
+char *TigerHeap::AllocateBlock(uint64_t size) {
+  char *block = FindFreeBlock(size);
+  if (block) NoteWritten(block + size);
+  return block;
+}
+
+char *TigerHeap::FindFreeBlock(uint64_t size) {
+  if (size <= SMALL_LIMIT) {
+    FreeBlock *&list = smallFree[size / WORD_SIZE];
+    if (list) {
+      char *block = (char *)list;
+      list = list->next;
+      return block;
     }
-    iter++;
   }
+  if (size <= (uint64_t)(bumpEnd - bumpPtr)) {
+    char *block = bumpPtr;
+    bumpPtr += size;
+    return block;
+  }
+  // 大块中best fit, 剩余部分放回空闲结构
+  auto iter = largeFree.lower_bound(size);
+  if (iter != largeFree.end()) {
+    char *block = iter->second;
+    uint64_t rest = iter->first - size;
+    largeFree.erase(iter);
+    if (rest) AddFreeBlock(block + size, rest);
+    return block;
+  }
+  // 更大的小块级别
+  for (uint64_t c = size / WORD_SIZE + 1; c < SIZE_CLASSES; c++)
+    if (smallFree[c]) {
+      char *block = (char *)smallFree[c];
+      smallFree[c] = smallFree[c]->next;
+      AddFreeBlock(block + size, c * WORD_SIZE - size);
+      return block;
+    }
+  return nullptr;
+}
 
-  SortIntervalBySize();
+void TigerHeap::AddFreeBlock(char *start, uint64_t size) {
+  if (size <= SMALL_LIMIT) {
+    NoteWritten(start + WORD_SIZE);
+    FreeBlock *block = (FreeBlock *)start;
+    block->next = smallFree[size / WORD_SIZE];
+    smallFree[size / WORD_SIZE] = block;
+  } else {
+    largeFree.emplace(size, start);
+  }
 }
 
-/* 寻找interval_size最接近(>=)size的空闲区间, 并将其从free_intervals中删除 */
-TigerHeap::freeIntervalInfo TigerHeap::FindFit(int size) {
-  auto iter = free_intervals.begin();
-  freeIntervalInfo bestFit;
-  while (iter != free_intervals.end()) {
-    if ((*iter).intervalSize == size) {
-      bestFit = (*iter);
-      free_intervals.erase(iter);
-      return bestFit;
-    }
-    if ((*iter).intervalSize > size) {
-      bestFit.intervalStart = (*iter).intervalStart;
-      bestFit.intervalSize = size;
-      bestFit.intervalEnd = (*iter).intervalStart + size;
-      freeIntervalInfo restInterval;
-      restInterval.intervalStart = bestFit.intervalEnd;
-      restInterval.intervalSize = (*iter).intervalSize - size;
-      restInterval.intervalEnd = (*iter).intervalEnd;
-      free_intervals.erase(iter);
-      free_intervals.push_back(restInterval);
-      // printf("erase interal(size = %d) and add interval(size  = %d)",
-      //        (int)bestFit.intervalSize, (int)restInterval.intervalSize);
-      SortIntervalBySize();
-      return bestFit;
+void TigerHeap::RebuildFreeSpace() {
+  std::vector<std::pair<char *, uint64_t>> live;
+  live.reserve(recordsInHeap.size() + arraiesInHeap.size() +
+               pinnedBlocks.size());
+  for (const recordInfo &record : recordsInHeap)
+    live.emplace_back(record.recordBeginPtr, record.recordSize);
+  for (const arrayInfo &array : arraiesInHeap)
+    live.emplace_back(array.arrayBeginPtr, array.arraySize);
+  for (const arrayInfo &block : pinnedBlocks)
+    live.emplace_back(block.arrayBeginPtr, block.arraySize);
+  std::sort(live.begin(), live.end(),
+            [](const std::pair<char *, uint64_t> &a,
+               const std::pair<char *, uint64_t> &b) {
+              return (uint64_t)a.first < (uint64_t)b.first;
+            });
+  ResizeOldSpace(live.empty() ? oldStart
+                             : live.back().first + live.back().second);
+  live.emplace_back(oldEnd, 0);
+
+  std::fill(std::begin(smallFree), std::end(smallFree), nullptr);
+  largeFree.clear();
+  bumpPtr = bumpEnd = nullptr;
+  char *gap = oldStart;
+  for (const auto &object : live) {
+    uint64_t size = object.first - gap;
+    if (size > (uint64_t)(bumpEnd - bumpPtr)) {
+      if (bumpEnd != bumpPtr) AddFreeBlock(bumpPtr, bumpEnd - bumpPtr);
+      bumpPtr = gap;
+      bumpEnd = object.first;
+    } else if (size) {
+      AddFreeBlock(gap, size);
     }
-    iter++;
+    gap = object.first + object.second;
   }
 }
 
+/* Alloc()接口: 调用者不登记对象, 块永不回收.
+   复制模式下heap中的块会被移动, 改从heap之外分配 */
 char *TigerHeap::Allocate(uint64_t size) {
-  if (size > MaxFree()) {
-    // std::cout << "space not enough" << std::endl;
+  size = AlignSize(size);
+  if (mode == COPYING) return (char *)malloc(size);
+  AbsorbInlineAllocations();
+  char *block = AllocateBlock(size);
+  PublishAllocationBuffer();
+  if (!block) {
+    failedSize = size;
     return nullptr;
   }
-  freeIntervalInfo interValToUse = FindFit(size);
-  return interValToUse.intervalStart;
+  pinnedBlocks.push_back({block, (int)size, false});
+  usedBytes += size;
+  return block;
 }
 
 char *TigerHeap::AllocateRecord(uint64_t size, int des_size,
                                 unsigned char *des_ptr, uint64_t *sp) {
   tigerStack = sp;
-  char *record_begin = Allocate(size);
-  if (!record_begin) return nullptr;
-  // std::cout << "alloc_record success" << std::endl;
+  size = AlignSize(size);
+  bool young = mode == GENERATIONAL;
+  AbsorbInlineAllocations();
+  char *record_begin = young ? AllocateYoung(size) : AllocateBlock(size);
+  PublishAllocationBuffer();
+  if (!record_begin) {
+    if (!young) failedSize = size;
+    return nullptr;
+  }
   recordInfo info;
   info.descriptor = des_ptr;
   info.descriptorSize = des_size;
   info.recordBeginPtr = record_begin;
   info.recordSize = size;
-  recordsInHeap.push_back(info);
+  RegisterObject(record_begin, Records(young).size(), false, young);
+  Records(young).push_back(info);
+  usedBytes += size;
+  if (stats) stats->CountRecord(des_ptr, des_size, size);
   return record_begin;
 }
 
-/* To ease your burden, you don't need to consider the situation that
-   program allocate pointer in array. */
-char *TigerHeap::AllocateArray(uint64_t size, uint64_t *sp) {
+/* 元素为指针的数组由init_array标明hasPointers, GC时逐个元素扫描.
+   concat和substring的结果也作为不含指针的数组分配在这里 */
+char *TigerHeap::AllocateArray(uint64_t size, uint64_t *sp, bool *zeroed,
+                               bool hasPointers) {
   tigerStack = sp;
-  char *array_begin = Allocate(size);
-  if (!array_begin) return nullptr;
+  size = AlignSize(size);
+  // 分代模式下大数组直接分配在老年代
+  bool young = mode == GENERATIONAL &&
+               size <= (uint64_t)(nurseryEnd - nurseryStart) / 2;
+  AbsorbInlineAllocations();
+  char *pristineBefore = pristine;
+  char *array_begin = young ? AllocateYoung(size) : AllocateBlock(size);
+  PublishAllocationBuffer();
+  if (!array_begin) {
+    if (!young) failedSize = size;
+    return nullptr;
+  }
+  if (zeroed) *zeroed = !young && array_begin >= pristineBefore;
   arrayInfo info;
   info.arrayBeginPtr = array_begin;
   info.arraySize = size;
-  arraiesInHeap.push_back(info);
-
+  info.hasPointers = hasPointers;
+  // 老年代中的指针数组由init_array填充初值, 不经过写屏障
+  if (hasPointers && mode == GENERATIONAL && !young)
+    MarkCards(array_begin, size);
+  RegisterObject(array_begin, Arraies(young).size(), true, young);
+  Arraies(young).push_back(info);
+  usedBytes += size;
+  if (stats) stats->CountArray(size);
   return array_begin;
 }
 
-uint64_t TigerHeap::Used() const {
-  uint64_t used = 0;
-  for (const recordInfo &info_rec : recordsInHeap) used += info_rec.recordSize;
-  for (const arrayInfo &info_arr : arraiesInHeap) used += info_arr.arraySize;
-  return used;
+char *TigerHeap::AllocateYoung(uint64_t size) {
+  if (size > (uint64_t)(nurseryEnd - nurseryPtr)) return nullptr;
+  char *block = nurseryPtr;
+  nurseryPtr += size;
+  return block;
 }
 
-uint64_t TigerHeap::MaxFree() const {
-  int maxFree = 0;
-  for (const freeIntervalInfo interval : free_intervals)
-    if (interval.intervalSize > maxFree) maxFree = interval.intervalSize;
-  // std::cout << "maxFree = " << maxFree << std::endl;
+void TigerHeap::AbsorbInlineAllocations() {
+  if (tiger_alloc_ptr == inlineParsed) return;
+  bool young = mode == GENERATIONAL;
+  char *object = inlineParsed;
+  while (object < tiger_alloc_ptr) {
+    // 头部字指向带头部'0'的descriptor, 格式同Tiger的string
+    const int *descriptor = *(const int **)object;
+    recordInfo info;
+    info.recordBeginPtr = object;
+    info.recordSize = *descriptor * WORD_SIZE;
+    info.descriptorSize = *descriptor;
+    info.descriptor = (unsigned char *)(descriptor + 1);
+    RegisterObject(object, Records(young).size(), false, young);
+    Records(young).push_back(info);
+    usedBytes += info.recordSize;
+    if (stats)
+      stats->CountRecord(info.descriptor, info.descriptorSize,
+                         info.recordSize);
+    object += info.recordSize;
+  }
+  if (!young) NoteWritten(tiger_alloc_ptr);
+  (young ? nurseryPtr : bumpPtr) = tiger_alloc_ptr;
+  inlineParsed = tiger_alloc_ptr;
+}
+
+void TigerHeap::PublishAllocationBuffer() {
+  bool young = mode == GENERATIONAL;
+  tiger_alloc_ptr = inlineParsed = young ? nurseryPtr : bumpPtr;
+  tiger_alloc_limit = young ? nurseryEnd : bumpEnd;
+}
+
+uint64_t TigerHeap::Used() {
+  AbsorbInlineAllocations();
+  return usedBytes;
+}
+
+uint64_t TigerHeap::MaxFree() {
+  AbsorbInlineAllocations();
+  uint64_t maxFree = bumpEnd - bumpPtr;
+  if (!largeFree.empty())
+    maxFree = std::max(maxFree, largeFree.rbegin()->first);
+  for (uint64_t c = SIZE_CLASSES - 1; c * WORD_SIZE > maxFree; c--)
+    if (smallFree[c]) return c * WORD_SIZE;
   return maxFree;
 }
 
-void TigerHeap::Initialize(uint64_t size) {
-  heap_root = (char *)malloc(size);
-  freeIntervalInfo freeInterval;
-  freeInterval.intervalStart = heap_root;
-  freeInterval.intervalSize = size;
-  freeInterval.intervalEnd = heap_root + size;  // sizeof(char)=1
-  // std::cout << "initialize heap success from "
-  //           << (long)freeInterval.intervalStart << " to "
-  //           << (long)freeInterval.intervalEnd << std::endl;
-  free_intervals.push_back(freeInterval);
+static inline uint64_t AlignChunk(uint64_t size) {
+  return (size + TigerHeap::CHUNK_SIZE - 1) & ~(TigerHeap::CHUNK_SIZE - 1);
+}
+
+/* 复制模式下size为每个semispace的大小; 分代模式下size为老年代的大小,
+   之前是size / 4的nursery. 保留最大大小的地址空间, 只有用到的页占用内存 */
+void TigerHeap::Initialize(uint64_t size, Mode mode_, uint64_t maxSize_,
+                           double targetOccupancy_) {
+  mode = mode_;
+  minSize = AlignChunk(size);
+  maxSize = std::max(minSize, AlignChunk(maxSize_));
+  targetOccupancy = targetOccupancy_;
+  semispaceSize = minSize;
+  uint64_t nurserySize = mode == GENERATIONAL ? AlignChunk(minSize / 4) : 0;
+  uint64_t reserved = mode == COPYING ? maxSize * 2 : nurserySize + maxSize;
+  heap_root = (char *)ReserveZeroed(reserved);
+  nurseryStart = nurseryPtr = heap_root;
+  nurseryEnd = heap_root + nurserySize;
+  oldStart = nurseryEnd;
+  oldEnd = oldStart + minSize;
+  heap_end = mode == COPYING ? heap_root + reserved : oldEnd;
+  fromSpace = heap_root;
+  bumpPtr = pristine = oldStart;
+  bumpEnd = oldEnd;
+  objectStarts.Resize(reserved / WORD_SIZE);
+  objectIndex = (uint32_t *)ReserveZeroed(reserved / WORD_SIZE *
+                                          sizeof(uint32_t));
+  markBits.Resize(reserved / WORD_SIZE);
   GetAllPointerMaps();
+  PublishAllocationBuffer();
+}
+
+/* 存活字节数占目标占用率, 且能放下needed字节, 在[minSize, maxSize]之内 */
+uint64_t TigerHeap::TargetSize(uint64_t live, uint64_t needed) const {
+  uint64_t target = std::max((uint64_t)(live / targetOccupancy), needed);
+  return std::min(std::max(AlignChunk(target), minSize), maxSize);
+}
+
+void TigerHeap::ResizeOldSpace(char *top) {
+  uint64_t committed = oldEnd - oldStart;
+  uint64_t target = TargetSize(usedBytes, (top - oldStart) + failedSize);
+  // 缩小有一倍的余量, 避免每次GC都在扩展和归还之间来回
+  if (target > committed || target <= committed / 2) {
+    char *newEnd = oldStart + target;
+    if (newEnd < oldEnd) {
+      madvise(newEnd, oldEnd - newEnd, MADV_DONTNEED);
+      pristine = std::min(pristine, newEnd);
+    }
+    oldEnd = newEnd;
+    heap_end = oldEnd;
+  }
+}
+
+bool TigerHeap::ExtendOldSpace(uint64_t size) {
+  size = AlignChunk(size);
+  if ((oldEnd - oldStart) + size > maxSize) return false;
+  if (bumpEnd != oldEnd) {
+    if (bumpEnd != bumpPtr) AddFreeBlock(bumpPtr, bumpEnd - bumpPtr);
+    bumpPtr = oldEnd;
+  }
+  oldEnd += size;
+  bumpEnd = heap_end = oldEnd;
+  return true;
 }
 
-void TigerHeap::Sweep(markResult bitMaps) {
+void TigerHeap::ResizeSemispaces(char *oldFromSpace) {
+  uint64_t live = copyFree - fromSpace;
+  uint64_t target = TargetSize(live, live + failedSize);
+  // 复制之后原from-space为空, 整个还给OS
+  madvise(oldFromSpace, semispaceSize, MADV_DONTNEED);
+  if (target > semispaceSize || target <= semispaceSize / 2) {
+    if (target < semispaceSize)
+      madvise(fromSpace + target, semispaceSize - target, MADV_DONTNEED);
+    semispaceSize = target;
+  }
+  bumpEnd = fromSpace + semispaceSize;
+  failedSize = 0;
+}
+
+/* 未标记的老年代对象清除起始位, 存活对象的编号随vector压缩更新.
+   nursery中的对象由之后的MinorGC处理 */
+void TigerHeap::Sweep() {
   std::vector<arrayInfo> new_arraiesInHeap;
-  for (int i = 0; i < bitMaps.arraiesActiveBitMap.size(); i++) {
-    if (bitMaps.arraiesActiveBitMap[i])  // marked, cannot sweep
-      new_arraiesInHeap.push_back(arraiesInHeap[i]);
-    else {
-      freeIntervalInfo freedInterval;
-      freedInterval.intervalStart = (char *)arraiesInHeap[i].arrayBeginPtr;
-      freedInterval.intervalSize = arraiesInHeap[i].arraySize;
-      freedInterval.intervalEnd =
-          (char *)arraiesInHeap[i].arrayBeginPtr + arraiesInHeap[i].arraySize;
-      free_intervals.push_back(freedInterval);
+  for (const arrayInfo &array : arraiesInHeap) {
+    uint64_t granule = (array.arrayBeginPtr - heap_root) / WORD_SIZE;
+    if (markBits.Test(granule)) {  // marked, cannot sweep
+      objectIndex[granule] = ObjectCode(new_arraiesInHeap.size(), true, false);
+      new_arraiesInHeap.push_back(array);
+    } else {
+      objectStarts.Clear(granule);
+      usedBytes -= array.arraySize;
     }
   }
   std::vector<recordInfo> new_recordsInHeap;
-  for (int i = 0; i < bitMaps.recordsActiveBitMap.size(); i++) {
-    if (bitMaps.recordsActiveBitMap[i])
-      new_recordsInHeap.push_back(recordsInHeap[i]);
-    else {
-      freeIntervalInfo freedInterval;
-      freedInterval.intervalStart = (char *)recordsInHeap[i].recordBeginPtr;
-      freedInterval.intervalSize = recordsInHeap[i].recordSize;
-      freedInterval.intervalEnd =
-          (char *)recordsInHeap[i].recordBeginPtr + recordsInHeap[i].recordSize;
-      free_intervals.push_back(freedInterval);
+  for (const recordInfo &record : recordsInHeap) {
+    uint64_t granule = (record.recordBeginPtr - heap_root) / WORD_SIZE;
+    if (markBits.Test(granule)) {
+      objectIndex[granule] = ObjectCode(new_recordsInHeap.size(), false, false);
+      new_recordsInHeap.push_back(record);
+    } else {
+      objectStarts.Clear(granule);
+      usedBytes -= record.recordSize;
     }
   }
-  recordsInHeap = new_recordsInHeap;
-  arraiesInHeap = new_arraiesInHeap;
-  // std::cout << "interval free size=" << free_intervals.size() << std::endl;
-  // std::cout << "new_recordsInHeap  size=" << new_recordsInHeap.size()
-  //           << std::endl;
-  Coalesce();
+  recordsInHeap = std::move(new_recordsInHeap);
+  arraiesInHeap = std::move(new_arraiesInHeap);
+  RebuildFreeSpace();
 }
 
-TigerHeap::markResult TigerHeap::Mark() {
-  std::vector<int> arraiesActiveBitMap(arraiesInHeap.size(), 0);
-  std::vector<int> recordsActiveBitMap(recordsInHeap.size(), 0);
+/* 迭代标记: GC的栈深度与数据结构的形状无关 */
+void TigerHeap::Mark() {
+  markBits.ClearRange(0, (heap_end - heap_root) / WORD_SIZE);
   std::vector<uint64_t> pointers = addressToMark();
-  for (uint64_t pointer : pointers)
-    MarkAnAddress(pointer, arraiesActiveBitMap, recordsActiveBitMap);
   //以pointer为root开始mark
-  markResult bitMaps;
-  bitMaps.arraiesActiveBitMap = arraiesActiveBitMap;
-  bitMaps.recordsActiveBitMap = recordsActiveBitMap;
-  return bitMaps;
+  for (uint64_t pointer : pointers) MarkAnAddress(pointer);
+  DrainMarkStack();
+  // 溢出时丢弃的record已标记但未扫描, 重新扫描全部已标记的record
+  while (markStackOverflow) {
+    markStackOverflow = false;
+    for (bool young : {false, true})
+      for (const recordInfo &record : Records(young))
+        if (markBits.Test((record.recordBeginPtr - heap_root) / WORD_SIZE)) {
+          ScanARecord(record);
+          DrainMarkStack();
+        }
+  }
+}
+
+void TigerHeap::DrainMarkStack() {
+  while (!markStack.empty() || !pendingArraies.empty()) {
+    if (!markStack.empty()) {
+      uint32_t code = markStack.back();
+      markStack.pop_back();
+      ScanARecord(Records(code & 2)[code >> 2]);
+      continue;
+    }
+    PendingArray pending = pendingArraies.back();
+    pendingArraies.pop_back();
+    ScanArrayChunk(pending);
+  }
+}
+
+/* 大数组分段扫描, 每段的元素入栈后先处理完, mark栈不会因为一个数组溢出 */
+void TigerHeap::ScanArrayChunk(PendingArray pending) {
+  const arrayInfo &array = Arraies(pending.code & 2)[pending.code >> 2];
+  uint64_t *elements = (uint64_t *)array.arrayBeginPtr;
+  uint32_t words = array.arraySize / WORD_SIZE;
+  uint32_t end = std::min(words, pending.next + ARRAY_SCAN_WORDS);
+  if (end < words) pendingArraies.push_back({pending.code, end});
+  for (uint32_t i = pending.next; i < end; i++) MarkAnAddress(elements[i]);
 }
 
-inline void TigerHeap::ScanARecord(recordInfo record,
-                                   std::vector<int> &arraiesActiveBitMap,
-                                   std::vector<int> &recordsActiveBitMap) {
-  // std::cout << (uint64_t)record.recordBeginPtr << std::endl;
+inline void TigerHeap::ScanARecord(const recordInfo &record) {
   long beginAddress = (long)record.recordBeginPtr;
   for (int i = 0; i < record.descriptorSize; i++)
     if (record.descriptor[i] == '1') {
       uint64_t targetAddress = *((uint64_t *)(beginAddress + WORD_SIZE * i));
       //存储指针的帧地址处存储的值
-      MarkAnAddress(targetAddress, arraiesActiveBitMap, recordsActiveBitMap);
+      MarkAnAddress(targetAddress);
     }
 }
 
-void TigerHeap::MarkAnAddress(uint64_t address,
-                              std::vector<int> &arraiesActiveBitMap,
-                              std::vector<int> &recordsActiveBitMap) {
-  int arraiesNUM = (int)arraiesActiveBitMap.size();
-  int recordsNUM = (int)recordsActiveBitMap.size();
+/* 解决指向某个中间地址的问题: 向前找到最近的对象起始位置 */
+bool TigerHeap::FindObject(uint64_t address, ObjectRef *object) const {
+  if (address < (uint64_t)heap_root || address >= (uint64_t)heap_end)
+    return false;
+  uint64_t granule = (address - (uint64_t)heap_root) / WORD_SIZE;
+  int64_t start = objectStarts.FindPrev(granule);
+  if (start < 0) return false;
+  uint32_t code = objectIndex[start];
+  object->index = code >> 2;
+  object->isArray = code & 1;
+  object->young = code & 2;
+  if (object->isArray)
+    object->size = (object->young ? youngArraies : arraiesInHeap)[object->index]
+                       .arraySize;
+  else
+    object->size = (object->young ? youngRecords : recordsInHeap)[object->index]
+                       .recordSize;
+  if (granule >= start + object->size / WORD_SIZE) return false;  // 空闲区间
+  object->granule = start;
+  object->begin = heap_root + start * WORD_SIZE;
+  return true;
+}
+
+void TigerHeap::MarkAnAddress(uint64_t address) {
+  ObjectRef object;
+  if (!FindObject(address, &object)) return;
+  if (markBits.Test(object.granule)) return;  //已经mark过，避免死循环
+  markBits.Set(object.granule);
+  markedBytes += object.size;
+  if (object.isArray) {
+    if (Arraies(object.young)[object.index].hasPointers)
+      pendingArraies.push_back(
+          {ObjectCode(object.index, true, object.young), 0});
+    return;
+  }
+  if (markStack.size() < MARK_STACK_LIMIT)
+    markStack.push_back(ObjectCode(object.index, false, object.young));
+  else
+    markStackOverflow = true;
+}
+
+void TigerHeap::GC() {
+  AbsorbInlineAllocations();
+  double start = stats ? stats->NowUs() : 0;
+  uint64_t usedBefore = usedBytes;
+  markedBytes = 0;
+  if (mode == COPYING) {
+    collectionKind = "copying";
+    CopyingGC();
+  } else if (mode == GENERATIONAL) {
+    GenerationalGC();
+  } else {
+    collectionKind = "mark-sweep";
+    Mark();
+    Sweep();
+    if (NeedCompact()) Compact();
+    failedSize = 0;
+  }
+  if (stats)
+    stats->AddCollection({collectionKind, start, stats->NowUs() - start,
+                          usedBefore, usedBytes, markedBytes, Committed(),
+                          Committed() - usedBytes, MaxFree()});
+  PublishAllocationBuffer();
+}
+
+uint64_t TigerHeap::Committed() const {
+  if (mode == COPYING) return semispaceSize;
+  return (oldEnd - oldStart) + (nurseryEnd - nurseryStart);
+}
 
-  for (int i = 0; i < arraiesNUM; i++) {
-    int delta = address - (uint64_t)arraiesInHeap[i].arrayBeginPtr;
-    //解决指向某个中间地址的问题
-    if (delta >= 0 && delta <= (arraiesInHeap[i].arraySize - 8)) {
-      arraiesActiveBitMap[i] = 1;
-      return;
+/*************** Copying GC ***************/
+/* Cheney算法: 从root出发把可达对象复制到to-space, 再按复制顺序扫描
+ * to-space中的record, 复制其引用的对象. 已复制对象的markBits置位,
+ * 首字改写为新地址(forwarding pointer). */
+void TigerHeap::CopyingGC() {
+  char *toSpace = fromSpace == heap_root ? heap_root + maxSize : heap_root;
+  copyFree = toSpace;
+  copiedRecords.clear();
+  copiedArraies.clear();
+  for (uint64_t *slot : rootSlots()) Forward(slot);
+  size_t scannedRecords = 0, scannedArraies = 0;
+  while (scannedRecords < copiedRecords.size() ||
+         scannedArraies < copiedArraies.size()) {
+    for (; scannedRecords < copiedRecords.size(); scannedRecords++) {
+      // Forward会向copiedRecords追加
+      recordInfo record = copiedRecords[scannedRecords];
+      for (int j = 0; j < record.descriptorSize; j++)
+        if (record.descriptor[j] == '1')
+          Forward((uint64_t *)(record.recordBeginPtr + WORD_SIZE * j));
+    }
+    for (; scannedArraies < copiedArraies.size(); scannedArraies++) {
+      arrayInfo array = copiedArraies[scannedArraies];
+      if (!array.hasPointers) continue;
+      for (int j = 0; j < array.arraySize; j += WORD_SIZE)
+        Forward((uint64_t *)(array.arrayBeginPtr + j));
     }
   }
-  int size = recordsInHeap.size();
-  for (int i = 0; i < recordsNUM; i++) {
-    int64_t delta = (int64_t)address - (int64_t)recordsInHeap[i].recordBeginPtr;
-    //解决指向某个中间地址的问题
-    if (delta >= 0 && delta <= (recordsInHeap[i].recordSize - 8)) {
-      if (recordsActiveBitMap[i])
-        return;  //已经扫描并mark过，不需要重复进行，避免死循环
-      else {
-        ScanARecord(recordsInHeap[i], arraiesActiveBitMap, recordsActiveBitMap);
-        recordsActiveBitMap[i] = 1;
-        return;
-      }
+
+  // from-space的对象全部作废
+  uint64_t fromGranule = (fromSpace - heap_root) / WORD_SIZE;
+  objectStarts.ClearRange(fromGranule, fromGranule + semispaceSize / WORD_SIZE);
+  markBits.ClearRange(fromGranule, fromGranule + semispaceSize / WORD_SIZE);
+  recordsInHeap.swap(copiedRecords);
+  arraiesInHeap.swap(copiedArraies);
+  char *oldFromSpace = fromSpace;
+  fromSpace = toSpace;
+  // 原to-space在上次GC时已整个madvise, 复制的对象之后仍全为0
+  bumpPtr = pristine = copyFree;
+  usedBytes = copyFree - toSpace;
+  ResizeSemispaces(oldFromSpace);
+}
+
+/* 若*slot指向from-space中的对象(可以指向对象中间), 复制该对象并更新*slot */
+void TigerHeap::Forward(uint64_t *slot) {
+  uint64_t address = *slot;
+  if (address < (uint64_t)fromSpace ||
+      address >= (uint64_t)fromSpace + semispaceSize)
+    return;
+  ObjectRef object;
+  if (!FindObject(address, &object) || object.begin < fromSpace) return;
+
+  if (!markBits.Test(object.granule)) {
+    char *copy = copyFree;
+    copyFree += object.size;
+    memcpy(copy, object.begin, object.size);
+    markedBytes += object.size;
+    if (object.isArray) {
+      arrayInfo array = arraiesInHeap[object.index];
+      array.arrayBeginPtr = copy;
+      RegisterObject(copy, copiedArraies.size(), true);
+      copiedArraies.push_back(array);
+    } else {
+      recordInfo record = recordsInHeap[object.index];
+      record.recordBeginPtr = copy;
+      RegisterObject(copy, copiedRecords.size(), false);
+      copiedRecords.push_back(record);
     }
+    markBits.Set(object.granule);
+    *(uint64_t *)object.begin = (uint64_t)copy;
   }
+  *slot = *(uint64_t *)object.begin + (address - (uint64_t)object.begin);
 }
+/*************** End Copying GC ***************/
 
-void TigerHeap::GC() {
-  markResult bitMaps = Mark();
-  Sweep(bitMaps);
+/*************** Mark-Compact ***************/
+bool TigerHeap::NeedCompact() {
+  uint64_t youngBytes = nurseryPtr - nurseryStart;
+  uint64_t free = (oldEnd - oldStart) - (usedBytes - youngBytes);
+  uint64_t maxFree = MaxFree();
+  // 空闲总量够而没有足够大的块, 或空闲空间过于零碎
+  if (failedSize > maxFree && free >= failedSize) return true;
+  return free >= CHUNK_SIZE && maxFree < free * COMPACT_MAX_FREE_RATIO;
+}
+
+/* 在sweep之后进行, 老年代中的对象都是存活的. 按地址顺序把对象滑动到
+ * 老年代开头, Alloc()得到的块不能移动, 之后的对象从块的结尾继续放置.
+ * 先计算新地址, 更新root和record字段, 再移动对象, 最后重建对象表和
+ * 空闲结构, 空闲空间只剩顶部的一块和pinned块之前的空隙 */
+void TigerHeap::Compact() {
+  collectionKind = mode == GENERATIONAL ? "full-compact" : "mark-compact";
+  struct LiveObject {
+    char *begin;
+    uint64_t size;
+    int kind;  // 0为record, 1为数组, 2为pinned块
+    uint32_t index;
+  };
+  std::vector<LiveObject> live;
+  live.reserve(recordsInHeap.size() + arraiesInHeap.size() +
+               pinnedBlocks.size());
+  for (uint32_t i = 0; i < recordsInHeap.size(); i++)
+    live.push_back({recordsInHeap[i].recordBeginPtr,
+                    (uint64_t)recordsInHeap[i].recordSize, 0, i});
+  for (uint32_t i = 0; i < arraiesInHeap.size(); i++)
+    live.push_back({arraiesInHeap[i].arrayBeginPtr,
+                    (uint64_t)arraiesInHeap[i].arraySize, 1, i});
+  for (uint32_t i = 0; i < pinnedBlocks.size(); i++)
+    live.push_back({pinnedBlocks[i].arrayBeginPtr,
+                    (uint64_t)pinnedBlocks[i].arraySize, 2, i});
+  std::sort(live.begin(), live.end(),
+            [](const LiveObject &a, const LiveObject &b) {
+              return (uint64_t)a.begin < (uint64_t)b.begin;
+            });
+
+  // 新地址不超过原地址, 所以不会越过之后的pinned块
+  recordForward.resize(recordsInHeap.size());
+  arrayForward.resize(arraiesInHeap.size());
+  char *dest = oldStart;
+  for (const LiveObject &object : live) {
+    if (object.kind == 2) {
+      dest = object.begin + object.size;
+      continue;
+    }
+    (object.kind ? arrayForward : recordForward)[object.index] = dest;
+    dest += object.size;
+  }
+
+  for (uint64_t *slot : rootSlots()) Relocate(slot);
+  for (bool young : {false, true})
+    for (const recordInfo &record : Records(young))
+      for (int j = 0; j < record.descriptorSize; j++)
+        if (record.descriptor[j] == '1')
+          Relocate((uint64_t *)(record.recordBeginPtr + WORD_SIZE * j));
+  for (bool young : {false, true})
+    for (const arrayInfo &array : Arraies(young))
+      if (array.hasPointers)
+        for (int j = 0; j < array.arraySize; j += WORD_SIZE)
+          Relocate((uint64_t *)(array.arrayBeginPtr + j));
+
+  // 按地址顺序移动, 目标区间可能与原区间重叠
+  for (const LiveObject &object : live) {
+    if (object.kind == 2) continue;
+    char *to = (object.kind ? arrayForward : recordForward)[object.index];
+    if (to != object.begin) memmove(to, object.begin, object.size);
+  }
+
+  uint64_t first = (oldStart - heap_root) / WORD_SIZE;
+  uint64_t last = (oldEnd - heap_root) / WORD_SIZE;
+  objectStarts.ClearRange(first, last);
+  markBits.ClearRange(first, last);
+  for (uint32_t i = 0; i < recordsInHeap.size(); i++) {
+    recordsInHeap[i].recordBeginPtr = recordForward[i];
+    RegisterObject(recordForward[i], i, false);
+  }
+  for (uint32_t i = 0; i < arraiesInHeap.size(); i++) {
+    arraiesInHeap[i].arrayBeginPtr = arrayForward[i];
+    RegisterObject(arrayForward[i], i, true);
+  }
+  RebuildFreeSpace();
+  // 移动后的record可能落在clean的card中, 下一次MinorGC扫描全部card
+  if (mode == GENERATIONAL) memset(tiger_card_table, 1, CARD_TABLE_SIZE);
+}
+
+void TigerHeap::Relocate(uint64_t *slot) {
+  uint64_t address = *slot;
+  if (address < (uint64_t)oldStart || address >= (uint64_t)oldEnd) return;
+  ObjectRef object;
+  if (!FindObject(address, &object) || object.young) return;
+  char *to = (object.isArray ? arrayForward : recordForward)[object.index];
+  *slot = (uint64_t)to + (address - (uint64_t)object.begin);
+}
+/*************** End Mark-Compact ***************/
+
+/*************** Generational GC ***************/
+void TigerHeap::GenerationalGC() {
+  uint64_t youngBytes = nurseryPtr - nurseryStart;
+  uint64_t oldFree = (oldEnd - oldStart) - (usedBytes - youngBytes);
+  // 老年代可能放不下全部晋升的对象, 或放不下刚才失败的大数组时,
+  // 先对整个heap标记, 清除老年代
+  collectionKind = "minor";
+  if (oldFree < youngBytes || MaxFree() < failedSize) {
+    collectionKind = "full";
+    Mark();
+    Sweep();
+    if (NeedCompact()) Compact();
+  }
+  failedSize = 0;
+  MinorGC();
+}
+
+/* 从root和dirty card出发把nursery中可达的对象复制到老年代, 然后清空nursery.
+ * 与复制模式相同, 已晋升对象的markBits置位, 首字改写为新地址 */
+void TigerHeap::MinorGC() {
+  uint64_t nurseryGranule = (nurseryStart - heap_root) / WORD_SIZE;
+  uint64_t nurseryGranules = (nurseryEnd - nurseryStart) / WORD_SIZE;
+  markBits.ClearRange(nurseryGranule, nurseryGranule + nurseryGranules);
+  promotedRecords.clear();
+  promotedArraies.clear();
+
+  for (uint64_t *slot : rootSlots()) Promote(slot);
+  // 老年代中被写过的card, 即remembered set
+  char *card = oldStart - (uint64_t)oldStart % CARD_SIZE;
+  for (; card < oldEnd; card += CARD_SIZE)
+    if (tiger_card_table[((uint64_t)card >> CARD_SHIFT) &
+                         (CARD_TABLE_SIZE - 1)])
+      ScanCard(card);
+  size_t scannedRecords = 0, scannedArraies = 0;
+  while (scannedRecords < promotedRecords.size() ||
+         scannedArraies < promotedArraies.size()) {
+    for (; scannedRecords < promotedRecords.size(); scannedRecords++) {
+      recordInfo record = recordsInHeap[promotedRecords[scannedRecords]];
+      for (int j = 0; j < record.descriptorSize; j++)
+        if (record.descriptor[j] == '1')
+          Promote((uint64_t *)(record.recordBeginPtr + WORD_SIZE * j));
+    }
+    for (; scannedArraies < promotedArraies.size(); scannedArraies++) {
+      arrayInfo array = arraiesInHeap[promotedArraies[scannedArraies]];
+      for (int j = 0; j < array.arraySize; j += WORD_SIZE)
+        Promote((uint64_t *)(array.arrayBeginPtr + j));
+    }
+  }
+
+  // nursery中不再有对象, 老年代也不再有指向nursery的指针
+  objectStarts.ClearRange(nurseryGranule, nurseryGranule + nurseryGranules);
+  markBits.ClearRange(nurseryGranule, nurseryGranule + nurseryGranules);
+  for (const recordInfo &record : youngRecords) usedBytes -= record.recordSize;
+  for (const arrayInfo &array : youngArraies) usedBytes -= array.arraySize;
+  youngRecords.clear();
+  youngArraies.clear();
+  nurseryPtr = nurseryStart;
+  memset(tiger_card_table, 0, CARD_TABLE_SIZE);
+}
+
+void TigerHeap::ScanCard(char *cardStart) {
+  char *cardEnd = cardStart + CARD_SIZE;
+  uint64_t first =
+      cardStart < heap_root ? 0 : (cardStart - heap_root) / WORD_SIZE;
+  uint64_t last = (std::min(cardEnd, oldEnd) - heap_root) / WORD_SIZE;
+  // 跨入card的对象从card之前开始
+  ObjectRef object;
+  int64_t start = objectStarts.FindPrev(first);
+  if (start < 0 || !FindObject((uint64_t)(heap_root + first * WORD_SIZE),
+                               &object))
+    start = objectStarts.FindNext(first, last);
+  for (; start >= 0; start = objectStarts.FindNext(start + 1, last)) {
+    if (!FindObject((uint64_t)(heap_root + start * WORD_SIZE), &object) ||
+        object.young)
+      continue;
+    if (object.isArray) {
+      // 只扫描数组落在本card中的部分
+      arrayInfo array = arraiesInHeap[object.index];
+      if (!array.hasPointers) continue;
+      char *begin = std::max(array.arrayBeginPtr, cardStart);
+      char *end = std::min(array.arrayBeginPtr + array.arraySize, cardEnd);
+      for (char *element = begin; element < end; element += WORD_SIZE)
+        Promote((uint64_t *)element);
+      continue;
+    }
+    recordInfo record = recordsInHeap[object.index];
+    for (int j = 0; j < record.descriptorSize; j++) {
+      char *field = record.recordBeginPtr + WORD_SIZE * j;
+      if (record.descriptor[j] == '1' && field >= cardStart && field < cardEnd)
+        Promote((uint64_t *)field);
+    }
+  }
+}
+
+void TigerHeap::MarkCards(char *begin, uint64_t size) {
+  uint64_t first = (uint64_t)begin >> CARD_SHIFT;
+  uint64_t last = ((uint64_t)begin + size - 1) >> CARD_SHIFT;
+  if (last - first >= CARD_TABLE_SIZE) {
+    memset(tiger_card_table, 1, CARD_TABLE_SIZE);
+    return;
+  }
+  for (uint64_t card = first; card <= last; card++)
+    tiger_card_table[card & (CARD_TABLE_SIZE - 1)] = 1;
+}
+
+/* 若*slot指向nursery中的对象, 把对象复制到老年代并更新*slot */
+void TigerHeap::Promote(uint64_t *slot) {
+  uint64_t address = *slot;
+  if (address < (uint64_t)nurseryStart || address >= (uint64_t)nurseryEnd)
+    return;
+  ObjectRef object;
+  if (!FindObject(address, &object) || !object.young) return;
+
+  if (!markBits.Test(object.granule)) {
+    char *copy = AllocateBlock(object.size);
+    if (!copy && ExtendOldSpace(object.size)) copy = AllocateBlock(object.size);
+    if (!copy) {
+      fprintf(stderr, "tiger: out of memory while promoting objects\n");
+      exit(1);
+    }
+    memcpy(copy, object.begin, object.size);
+    usedBytes += object.size;
+    markedBytes += object.size;
+    if (object.isArray) {
+      arrayInfo array = youngArraies[object.index];
+      array.arrayBeginPtr = copy;
+      if (array.hasPointers) promotedArraies.push_back(arraiesInHeap.size());
+      RegisterObject(copy, arraiesInHeap.size(), true);
+      arraiesInHeap.push_back(array);
+    } else {
+      recordInfo record = youngRecords[object.index];
+      record.recordBeginPtr = copy;
+      promotedRecords.push_back(recordsInHeap.size());
+      RegisterObject(copy, recordsInHeap.size(), false);
+      recordsInHeap.push_back(record);
+    }
+    markBits.Set(object.granule);
+    *(uint64_t *)object.begin = (uint64_t)copy;
+  }
+  *slot = *(uint64_t *)object.begin + (address - (uint64_t)object.begin);
+}
+/*************** End Generational GC ***************/
+
+/*************** Statistics ***************/
+GCStats::GCStats(const char *mode_, const char *tracePath_)
+    : mode(mode_),
+      tracePath(tracePath_ ? tracePath_ : ""),
+      start(std::chrono::steady_clock::now()) {}
+
+void GCStats::CountRecord(const unsigned char *descriptor, int descriptorSize,
+                          uint64_t size) {
+  // descriptor是编译器生成的字符串常量, 同一record类型的地址相同
+  auto iter = records.find(descriptor);
+  if (iter == records.end())
+    iter = records
+               .emplace(descriptor,
+                        RecordCount{std::string((const char *)descriptor,
+                                                descriptorSize),
+                                    size, {}})
+               .first;
+  iter->second.alloc.count++;
+  iter->second.alloc.bytes += size;
+}
+
+void GCStats::Report(FILE *out) const {
+  double totalUs = NowUs();
+  double pauseUs = 0, maxPauseUs = 0;
+  uint64_t freed = 0, marked = 0;
+  // 暂停时间按2的幂(微秒)分级
+  uint64_t histogram[32] = {};
+  for (const Collection &collection : collections) {
+    pauseUs += collection.pauseUs;
+    maxPauseUs = std::max(maxPauseUs, collection.pauseUs);
+    if (collection.usedBefore > collection.usedAfter)
+      freed += collection.usedBefore - collection.usedAfter;
+    marked += collection.markedBytes;
+    int bucket = 0;
+    while (bucket < 31 && (1ull << bucket) <= collection.pauseUs) bucket++;
+    histogram[bucket]++;
+  }
+  AllocCount recordTotal, arrayTotal;
+  for (const auto &record : records) {
+    recordTotal.count += record.second.alloc.count;
+    recordTotal.bytes += record.second.alloc.bytes;
+  }
+  for (const AllocCount &bucket : arrays) {
+    arrayTotal.count += bucket.count;
+    arrayTotal.bytes += bucket.bytes;
+  }
+
+  fprintf(out, "==== tiger gc statistics (%s) ====\n", mode.c_str());
+  fprintf(out, "run time          %.3f ms\n", totalUs / 1000);
+  fprintf(out, "collections       %zu, pause total %.3f ms, max %.3f ms\n",
+          collections.size(), pauseUs / 1000, maxPauseUs / 1000);
+  fprintf(out, "marked/copied     %lu bytes\n", (unsigned long)marked);
+  fprintf(out, "freed             %lu bytes\n", (unsigned long)freed);
+  fprintf(out, "allocated         %lu records (%lu bytes), %lu arrays (%lu "
+               "bytes)\n",
+          (unsigned long)recordTotal.count, (unsigned long)recordTotal.bytes,
+          (unsigned long)arrayTotal.count, (unsigned long)arrayTotal.bytes);
+  if (totalUs > 0)
+    fprintf(out, "allocation rate   %.2f MB/s\n",
+            (recordTotal.bytes + arrayTotal.bytes) / totalUs);
+  if (!collections.empty()) {
+    const Collection &last = collections.back();
+    fprintf(out,
+            "last collection   committed %lu, free %lu, max free %lu "
+            "(fragmentation %.1f%%)\n",
+            (unsigned long)last.committed, (unsigned long)last.freeBytes,
+            (unsigned long)last.maxFree,
+            last.freeBytes
+                ? 100.0 * (last.freeBytes - last.maxFree) / last.freeBytes
+                : 0.0);
+    fprintf(out, "pause histogram\n");
+    for (int i = 0; i < 32; i++)
+      if (histogram[i])
+        fprintf(out, "  < %8llu us  %lu\n", 1ull << i,
+                (unsigned long)histogram[i]);
+  }
+  if (!records.empty()) {
+    fprintf(out, "records by descriptor\n");
+    for (const auto &record : records)
+      fprintf(out, "  %-16s %6lu bytes  %10lu allocs  %12lu bytes\n",
+              record.second.descriptor.c_str(),
+              (unsigned long)record.second.size,
+              (unsigned long)record.second.alloc.count,
+              (unsigned long)record.second.alloc.bytes);
+  }
+  if (arrayTotal.count) {
+    fprintf(out, "arrays by size class\n");
+    for (int i = 0; i < 65; i++)
+      if (arrays[i].count)
+        fprintf(out, "  <= %-12llu %10lu allocs  %12lu bytes\n",
+                i == 64 ? ~0ull : 1ull << i, (unsigned long)arrays[i].count,
+                (unsigned long)arrays[i].bytes);
+  }
+}
+
+void GCStats::WriteJson(FILE *out) const {
+  fprintf(out, "{\"mode\": \"%s\", \"total_us\": %.1f,\n", mode.c_str(),
+          NowUs());
+  fprintf(out, " \"collections\": [");
+  for (size_t i = 0; i < collections.size(); i++) {
+    const Collection &c = collections[i];
+    fprintf(out,
+            "%s\n  {\"kind\": \"%s\", \"start_us\": %.1f, \"pause_us\": "
+            "%.1f, \"used_before\": %lu, \"used_after\": %lu, "
+            "\"marked\": %lu, \"committed\": %lu, \"free\": %lu, "
+            "\"max_free\": %lu}",
+            i ? "," : "", c.kind, c.startUs, c.pauseUs,
+            (unsigned long)c.usedBefore, (unsigned long)c.usedAfter,
+            (unsigned long)c.markedBytes, (unsigned long)c.committed,
+            (unsigned long)c.freeBytes, (unsigned long)c.maxFree);
+  }
+  fprintf(out, "],\n \"records\": [");
+  bool first = true;
+  for (const auto &record : records) {
+    fprintf(out,
+            "%s\n  {\"descriptor\": \"%s\", \"size\": %lu, \"count\": "
+            "%lu, \"bytes\": %lu}",
+            first ? "" : ",", record.second.descriptor.c_str(),
+            (unsigned long)record.second.size,
+            (unsigned long)record.second.alloc.count,
+            (unsigned long)record.second.alloc.bytes);
+    first = false;
+  }
+  fprintf(out, "],\n \"arrays\": [");
+  first = true;
+  for (int i = 0; i < 65; i++)
+    if (arrays[i].count) {
+      fprintf(out,
+              "%s\n  {\"max_bytes\": %llu, \"count\": %lu, \"bytes\": "
+              "%lu}",
+              first ? "" : ",", i == 64 ? ~0ull : 1ull << i,
+              (unsigned long)arrays[i].count, (unsigned long)arrays[i].bytes);
+      first = false;
+    }
+  fprintf(out, "]}\n");
 }
 
+void TigerHeap::EnableStats(const char *tracePath) {
+  const char *modeName[] = {"mark-sweep", "copying", "generational"};
+  stats = new GCStats(modeName[mode], tracePath);
+}
+
+void TigerHeap::ReportStats() {
+  if (!stats) return;
+  AbsorbInlineAllocations();
+  stats->Report(stderr);
+  if (!stats->TracePath()) return;
+  FILE *trace = fopen(stats->TracePath(), "w");
+  if (!trace) {
+    fprintf(stderr, "tiger: cannot write gc trace %s\n", stats->TracePath());
+    return;
+  }
+  stats->WriteJson(trace);
+  fclose(trace);
+}
+/*************** End Statistics ***************/
 
 /*************** Root Protocol ***************/
 /* 读取pointerMaps */
@@ -262,13 +962,37 @@ void TigerHeap::GetAllPointerMaps() {
                                         frameSize, isMain, offsets));
     if (nextPointerMapAddress == 0) break;
   }
+  BuildPointerMapIndex();
   // std::cout << "successfully read pointerMaps" << std::endl;
   // printPointerMap();
 }
 
-/* 返回栈中的root */
-std::vector<uint64_t> TigerHeap::addressToMark() {
-  std::vector<uint64_t> pointers;
+/* 以return address为key的开放寻址表, 大小为2的幂且至少是map数目的两倍 */
+void TigerHeap::BuildPointerMapIndex() {
+  uint64_t capacity = 16;
+  while (capacity < pointerMaps.size() * 2) capacity *= 2;
+  pointerMapIndex.assign(capacity, 0);
+  for (uint32_t i = 0; i < pointerMaps.size(); i++) {
+    uint64_t slot = PointerMapHash(pointerMaps[i].returnAddress);
+    while (pointerMapIndex[slot]) slot = (slot + 1) & (capacity - 1);
+    pointerMapIndex[slot] = i + 1;
+  }
+}
+
+const TigerHeap::PointerMapBin *TigerHeap::FindPointerMap(
+    uint64_t returnAddress) const {
+  uint64_t slot = PointerMapHash(returnAddress);
+  for (; pointerMapIndex[slot];
+       slot = (slot + 1) & (pointerMapIndex.size() - 1)) {
+    const PointerMapBin &pointMap = pointerMaps[pointerMapIndex[slot] - 1];
+    if (pointMap.returnAddress == returnAddress) return &pointMap;
+  }
+  return nullptr;
+}
+
+/* 返回栈中存放root的位置, 移动对象后通过它们更新root */
+std::vector<uint64_t *> TigerHeap::rootSlots() {
+  std::vector<uint64_t *> slots;
   uint64_t *sp = tigerStack;  // sp为alloc_record的RBP
   /* 每个loop开始时sp指向函数的帧底
    * (1)首先-8(-1 * uint64_t)得到return address
@@ -278,22 +1002,28 @@ std::vector<uint64_t> TigerHeap::addressToMark() {
    *  */
   bool isMain = false;
   while (!isMain) {
-    uint64_t returnAddress = *(sp - 1);  //(1)
-    for (const PointerMapBin &pointMap : pointerMaps)
-      if (pointMap.returnAddress == returnAddress) {
-        for (int64_t offset : pointMap.offsets) {
-          uint64_t *pointerAddress =
-              (uint64_t *)(offset + (int64_t)sp + (int64_t)pointMap.frameSize);
-          pointers.push_back(*pointerAddress);  //(2)
-        }
-
-        sp += (pointMap.frameSize / WORD_SIZE + 1);
-        // std::cout << "mark pointers with return address: " << returnAddress
-        //           << std::endl;
-        isMain = pointMap.isMain;
-        break;
-      }
+    const PointerMapBin *pointMap = FindPointerMap(*(sp - 1));  //(1)
+    if (!pointMap) {
+      fprintf(stderr, "tiger: no pointer map for return address %#lx\n",
+              (unsigned long)*(sp - 1));
+      exit(1);
+    }
+    for (int64_t offset : pointMap->offsets) {
+      uint64_t *pointerAddress =
+          (uint64_t *)(offset + (int64_t)sp + (int64_t)pointMap->frameSize);
+      slots.push_back(pointerAddress);  //(2)
+    }
+    sp += (pointMap->frameSize / WORD_SIZE + 1);  //(3)
+    isMain = pointMap->isMain;                    //(4)
   }
+  slots.insert(slots.end(), runtimeRoots.begin(), runtimeRoots.end());
+  return slots;
+}
+
+/* 返回栈中的root */
+std::vector<uint64_t> TigerHeap::addressToMark() {
+  std::vector<uint64_t> pointers;
+  for (uint64_t *slot : rootSlots()) pointers.push_back(*slot);
   return pointers;
 }
 /*************** End Root Protocol ***************/
@@ -2,19 +2,169 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <map>
+#include <string>
+#include <unordered_map>
 #include <vector>
+
+#include "../alloc/alloc.h"
+#include "../barrier/barrier.h"
 // Used to locate the start of ptrmap, simply get the address by
 // &GLOBAL_GC_ROOTS
 extern uint64_t GLOBAL_GC_ROOTS;
+// 写屏障标记的card table, 定义在runtime中
+extern unsigned char tiger_card_table[];
+// 内联分配的缓冲区, 定义在runtime中
+extern char *tiger_alloc_ptr;
+extern char *tiger_alloc_limit;
 
 namespace gc {
 
 constexpr long END_MARK = 0;
 
+/* 保留一段全零的匿名映射, 未访问的页不占物理内存 */
+inline void *ReserveZeroed(uint64_t bytes) {
+  void *start = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (start == MAP_FAILED) {
+    fprintf(stderr, "tiger: cannot reserve %lu bytes\n", (unsigned long)bytes);
+    exit(1);
+  }
+  return start;
+}
+
+/* 每个heap字(granule)一位的位图, 覆盖heap的整个保留区间 */
+class Bitmap {
+ public:
+  Bitmap() = default;
+  Bitmap(const Bitmap &) = delete;
+  Bitmap &operator=(const Bitmap &) = delete;
+  ~Bitmap() {
+    if (words) munmap(words, size * sizeof(uint64_t));
+  }
+
+  void Resize(uint64_t bits) {
+    if (words) munmap(words, size * sizeof(uint64_t));
+    size = (bits + 63) / 64;
+    words = (uint64_t *)ReserveZeroed(size * sizeof(uint64_t));
+  }
+  bool Test(uint64_t i) const { return words[i / 64] >> (i % 64) & 1; }
+  void Set(uint64_t i) { words[i / 64] |= 1ull << (i % 64); }
+  void Clear(uint64_t i) { words[i / 64] &= ~(1ull << (i % 64)); }
+  /* 清除[begin, end)中的位 */
+  void ClearRange(uint64_t begin, uint64_t end) {
+    for (; begin < end && begin % 64; begin++) Clear(begin);
+    for (; begin + 64 <= end; begin += 64) words[begin / 64] = 0;
+    for (; begin < end; begin++) Clear(begin);
+  }
+
+  /* [i, end)中第一个置位的位置, 没有则返回-1 */
+  int64_t FindNext(uint64_t i, uint64_t end) const {
+    if (i >= end) return -1;
+    uint64_t w = i / 64;
+    uint64_t word = words[w] & (~0ull << (i % 64));
+    while (!word) {
+      if (++w * 64 >= end) return -1;
+      word = words[w];
+    }
+    uint64_t found = w * 64 + __builtin_ctzll(word);
+    return found < end ? found : -1;
+  }
+
+  /* 不大于i的最后一个置位的位置, 没有则返回-1 */
+  int64_t FindPrev(uint64_t i) const {
+    uint64_t w = i / 64;
+    uint64_t word = words[w] & (~0ull >> (63 - i % 64));
+    while (!word) {
+      if (w == 0) return -1;
+      word = words[--w];
+    }
+    return w * 64 + 63 - __builtin_clzll(word);
+  }
+
+ private:
+  uint64_t *words = nullptr;
+  uint64_t size = 0;
+};
+
+/* TIGER_GC_STATS打开的统计: 每次GC的暂停时间, 标记和回收的字节数, 碎片,
+ * 按record descriptor和数组大小级别的分配计数. 程序结束时输出汇总,
+ * 可选地写出JSON trace */
+class GCStats {
+ public:
+  struct Collection {
+    const char *kind;
+    double startUs;
+    double pauseUs;
+    uint64_t usedBefore;
+    uint64_t usedAfter;
+    uint64_t markedBytes;  // 标记或复制的字节数
+    uint64_t committed;
+    uint64_t freeBytes;
+    uint64_t maxFree;
+  };
+
+  struct AllocCount {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+  };
+
+  GCStats(const char *mode_, const char *tracePath_);
+
+  double NowUs() const {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  }
+
+  void CountRecord(const unsigned char *descriptor, int descriptorSize,
+                   uint64_t size);
+
+  void CountArray(uint64_t size) {
+    AllocCount &bucket = arrays[SizeClass(size)];
+    bucket.count++;
+    bucket.bytes += size;
+  }
+
+  void AddCollection(const Collection &collection) {
+    collections.push_back(collection);
+  }
+
+  void Report(FILE *out) const;
+
+  void WriteJson(FILE *out) const;
+
+  const char *TracePath() const {
+    return tracePath.empty() ? nullptr : tracePath.c_str();
+  }
+
+ private:
+  /* 数组按2的幂分级, 第i级为(2^(i-1), 2^i]字节 */
+  static int SizeClass(uint64_t size) {
+    return size <= 1 ? 0 : 64 - __builtin_clzll(size - 1);
+  }
+
+  struct RecordCount {
+    std::string descriptor;
+    uint64_t size;
+    AllocCount alloc;
+  };
+
+  std::string mode;
+  std::string tracePath;
+  std::chrono::steady_clock::time_point start;
+  std::vector<Collection> collections;
+  std::unordered_map<const unsigned char *, RecordCount> records;
+  AllocCount arrays[65];
+};
+
 class TigerHeap {
  public:
   /***************** necessary protocols********************/
@@ -28,33 +178,9 @@ class TigerHeap {
   struct arrayInfo {
     char *arrayBeginPtr;
     int arraySize;
+    bool hasPointers;  // 元素为record/数组/string, GC时扫描每个元素
   };
 
-  struct freeIntervalInfo {
-    char *intervalStart;
-    uint64_t intervalSize;
-    char *intervalEnd;
-  };
-
-  struct markResult {
-    std::vector<int> arraiesActiveBitMap;
-    std::vector<int> recordsActiveBitMap;
-  };
-
-  /* ascending */
-  static inline bool compareIntervalBySize(freeIntervalInfo interval1,
-                                           freeIntervalInfo interval2) {
-    return interval1.intervalSize < interval2.intervalSize;
-  }
-
-  /* ascending */
-  static inline bool compareIntervalByStartAddr(freeIntervalInfo interval1,
-                                                freeIntervalInfo interval2) {
-    return (uint64_t)interval1.intervalStart <
-           (uint64_t)interval2.intervalStart;
-    // important!!!比较指针时转为uint64_t, 不要直接比较
-  }
-
   /* 给heap中GC提供的结构(link后) */
   struct PointerMapBin {
     uint64_t returnAddress;
@@ -74,59 +200,261 @@ class TigerHeap {
 
   /***************** end necessary protocols ********************/
 
+  /* MARK_SWEEP: 不移动对象的标记清除; COPYING: Cheney semispace复制;
+     GENERATIONAL: bump分配的nursery加上标记清除的老年代 */
+  enum Mode { MARK_SWEEP, COPYING, GENERATIONAL };
+
   TigerHeap() = default;
 
   ~TigerHeap() = default;
 
-  inline void SortIntervalBySize();
-
-  inline void SortIntervalByStartAddr();
-
-  void Coalesce();
-
-  freeIntervalInfo FindFit(int size);
-
   char *Allocate(uint64_t size);
 
   char *AllocateRecord(uint64_t size, int des_size, unsigned char *des_ptr,
                        uint64_t *sp);
 
-  char *AllocateArray(uint64_t size, uint64_t *sp);
+  /* zeroed非空时返回分配到的内存是否已全为0(从未写过的页).
+     hasPointers的数组中每个字都是指针或nil */
+  char *AllocateArray(uint64_t size, uint64_t *sp, bool *zeroed = nullptr,
+                      bool hasPointers = false);
 
-  uint64_t Used() const;
+  uint64_t Used();
 
-  uint64_t MaxFree() const;
+  uint64_t MaxFree();
 
-  void Initialize(uint64_t size);
+  /* size为初始大小, heap在GC后按targetOccupancy扩展到最多maxSize_,
+     maxSize_为0时大小固定 */
+  void Initialize(uint64_t size, Mode mode_ = MARK_SWEEP, uint64_t maxSize_ = 0,
+                  double targetOccupancy_ = 0.5);
 
-  void Sweep(markResult bitMaps);
+  void Sweep();
 
-  markResult Mark();
+  void Mark();
 
-  inline void ScanARecord(recordInfo record,
-                          std::vector<int> &arraiesActiveBitMap,
-                          std::vector<int> &recordsActiveBitMap);
+  inline void ScanARecord(const recordInfo &record);
 
-  void MarkAnAddress(uint64_t address, std::vector<int> &arraiesActiveBitMap,
-                     std::vector<int> &recordsActiveBitMap);
+  /* 标记address所在的对象, record和指针数组入栈等待扫描 */
+  void MarkAnAddress(uint64_t address);
+
+  void DrainMarkStack();
 
   void GC();
 
+  /* 打开统计, tracePath非空时在ReportStats中写出JSON trace */
+  void EnableStats(const char *tracePath);
+
+  /* 向stderr输出统计汇总, 统计未打开时什么也不做 */
+  void ReportStats();
+
+  /* runtime函数中跨越分配持有的heap指针. 登记的slot在GC时作为root,
+   * 对象移动后被更新; 按登记的逆序PopRoots */
+  void PushRoot(void *slot) { runtimeRoots.push_back((uint64_t *)slot); }
+
+  void PopRoots(int count) {
+    runtimeRoots.resize(runtimeRoots.size() - count);
+  }
+
   static constexpr uint64_t WORD_SIZE = 8;
 
+  /* heap扩展和归还给OS的粒度 */
+  static constexpr uint64_t CHUNK_SIZE = 1 << 16;
+  /* 最大空闲块不到空闲总量的这一比例时压缩 */
+  static constexpr double COMPACT_MAX_FREE_RATIO = 0.5;
+
   void GetAllPointerMaps();
 
   std::vector<uint64_t> addressToMark();
 
+  std::vector<uint64_t *> rootSlots();
+
  private:
+  /* 小于等于SMALL_LIMIT的块按8字节分级, 每级一个空闲链表 */
+  static constexpr uint64_t SMALL_LIMIT = 256;
+  static constexpr int SIZE_CLASSES = SMALL_LIMIT / WORD_SIZE + 1;
+  /* mark栈最多的record数, 溢出后重新扫描已标记的record */
+  static constexpr uint64_t MARK_STACK_LIMIT = 1 << 20;
+  /* 指针数组每次扫描的字数, 扫描完一段先处理mark栈中的record */
+  static constexpr uint32_t ARRAY_SCAN_WORDS = 1024;
+
+  /* 已标记的指针数组从next开始尚未扫描 */
+  struct PendingArray {
+    uint32_t code;
+    uint32_t next;
+  };
+
+  void ScanArrayChunk(PendingArray pending);
+
+  /* 标记[begin, begin + size)所在的card */
+  void MarkCards(char *begin, uint64_t size);
+
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
   void printPointerMap();
 
+  /* 栈扫描时按return address查找pointer map, 每帧O(1) */
+  void BuildPointerMapIndex();
+
+  const PointerMapBin *FindPointerMap(uint64_t returnAddress) const;
+
+  uint64_t PointerMapHash(uint64_t returnAddress) const {
+    return (returnAddress * 0x9E3779B97F4A7C15ull >> 32) &
+           (pointerMapIndex.size() - 1);
+  }
+
+  /* 登记生成的代码在内联分配缓冲区中分配的record, 更新bump指针.
+     public的入口在访问heap之前调用 */
+  void AbsorbInlineAllocations();
+
+  /* 把当前的bump区间(分代模式下为nursery)作为内联分配缓冲区交给生成的代码.
+     public的入口在修改heap之后调用 */
+  void PublishAllocationBuffer();
+
+  /* 按分级链表, 当前bump区间, 大块best-fit的顺序分配, size已对齐到8 */
+  char *AllocateBlock(uint64_t size);
+
+  char *FindFreeBlock(uint64_t size);
+
+  // 记录[.., end)可能已被写过
+  void NoteWritten(char *end) { pristine = std::max(pristine, end); }
+
+  void AddFreeBlock(char *start, uint64_t size);
+
+  /* sweep后由存活对象之间的空隙重建空闲结构, 最大的空隙作为bump区间 */
+  void RebuildFreeSpace();
+
+  /* 按目标占用率调整老年代的大小, top为最高的存活对象的结尾.
+     缩小时顶部的chunk用madvise还给OS */
+  void ResizeOldSpace(char *top);
+
+  /* 在老年代顶部追加至少size字节, 超出maxSize时失败 */
+  bool ExtendOldSpace(uint64_t size);
+
+  /* 复制后按目标占用率调整semispace的大小, 并归还空的from-space */
+  void ResizeSemispaces(char *oldFromSpace);
+
+  uint64_t TargetSize(uint64_t live, uint64_t needed) const;
+
+  /* 当前提交的heap大小 */
+  uint64_t Committed() const;
+
+  void CopyingGC();
+
+  void Forward(uint64_t *slot);
+
+  /* sweep之后空闲空间过于零碎时, 滑动压缩老年代中的存活对象 */
+  bool NeedCompact();
+
+  void Compact();
+
+  /* 若*slot指向老年代中的对象, 改为对象压缩后的地址 */
+  void Relocate(uint64_t *slot);
+
+  /* 分代模式: 先按需要对老年代做标记清除, 再把nursery中存活的对象晋升 */
+  void GenerationalGC();
+
+  void MinorGC();
+
+  /* 扫描card中的record字段, 晋升其引用的nursery对象 */
+  void ScanCard(char *cardStart);
+
+  void Promote(uint64_t *slot);
+
+  char *AllocateYoung(uint64_t size);
+
+  /* objectIndex中的编码: 下标 << 2 | 是否在nursery << 1 | 是否为数组 */
+  static uint32_t ObjectCode(uint32_t index, bool isArray, bool young) {
+    return index << 2 | young << 1 | isArray;
+  }
+
+  void RegisterObject(char *start, uint32_t index, bool isArray,
+                      bool young = false) {
+    uint64_t granule = (start - heap_root) / WORD_SIZE;
+    objectStarts.Set(granule);
+    objectIndex[granule] = ObjectCode(index, isArray, young);
+  }
+
+  /* address(可以指向对象中间)所在的对象 */
+  struct ObjectRef {
+    char *begin;
+    uint64_t size;
+    uint64_t granule;  // 起始字
+    uint32_t index;
+    bool isArray;
+    bool young;
+  };
+  bool FindObject(uint64_t address, ObjectRef *object) const;
+
+  std::vector<recordInfo> &Records(bool young) {
+    return young ? youngRecords : recordsInHeap;
+  }
+  std::vector<arrayInfo> &Arraies(bool young) {
+    return young ? youngArraies : arraiesInHeap;
+  }
+
   char *heap_root;
+  char *heap_end;  // 可能有对象的范围为[heap_root, heap_end)
+  char *oldStart;  // 标记清除管理的空间为[oldStart, oldEnd)
+  char *oldEnd;
+  uint64_t minSize = 0;  // 老年代或semispace的初始大小和最大大小
+  uint64_t maxSize = 0;
+  double targetOccupancy = 0.5;
   std::vector<recordInfo> recordsInHeap;
   std::vector<arrayInfo> arraiesInHeap;
-  std::vector<freeIntervalInfo> free_intervals;
+  std::vector<arrayInfo> pinnedBlocks;  // Alloc()得到的块, 不会被回收
   std::vector<PointerMapBin> pointerMaps;
+  std::vector<uint32_t> pointerMapIndex;  // pointerMaps下标 + 1, 0为空
   uint64_t *tigerStack;
+  std::vector<uint64_t *> runtimeRoots;
+
+  FreeBlock *smallFree[SIZE_CLASSES] = {};  // 下标为size / WORD_SIZE
+  std::multimap<uint64_t, char *> largeFree;  // size -> start
+  char *bumpPtr = nullptr;
+  char *bumpEnd = nullptr;
+  char *inlineParsed = nullptr;  // 内联分配缓冲区中已登记的部分的结尾
+  /* 老年代(复制模式下为当前semispace)中此地址之后的内存mmap或madvise之后
+     从未写过, 全为0, 分配在这里的数组不需要再清零 */
+  char *pristine = nullptr;
+  uint64_t usedBytes = 0;
+  uint64_t failedSize = 0;  // 上次失败的分配, GC后保证能放下
+
+  /* 对象起始位图和起始字上的对象编号, 任意地址向前找到最近的起始位即得到
+     所在对象; 标记位同样按起始字记录 */
+  Bitmap objectStarts;
+  uint32_t *objectIndex = nullptr;
+  Bitmap markBits;
+  Mode mode = MARK_SWEEP;
+  /* 复制模式: 两个semispace分别从heap_root和heap_root + maxSize开始.
+     当前分配的semispace, 复制的目标位置和复制出的对象 */
+  char *fromSpace = nullptr;
+  uint64_t semispaceSize = 0;
+  char *copyFree = nullptr;
+  std::vector<recordInfo> copiedRecords;
+  std::vector<arrayInfo> copiedArraies;
+
+  /* 压缩模式: 每个record和数组压缩后的地址 */
+  std::vector<char *> recordForward;
+  std::vector<char *> arrayForward;
+
+  /* 分代模式: nursery在heap开头, 之后是可以扩展的老年代.
+     nursery中的对象记录在young*中 */
+  char *nurseryStart = nullptr;
+  char *nurseryPtr = nullptr;
+  char *nurseryEnd = nullptr;
+  std::vector<recordInfo> youngRecords;
+  std::vector<arrayInfo> youngArraies;
+  std::vector<uint32_t> promotedRecords;  // 晋升后待扫描的record下标
+  std::vector<uint32_t> promotedArraies;  // 晋升后待扫描的指针数组下标
+
+  GCStats *stats = nullptr;
+  const char *collectionKind = "";  // 本次GC的种类, 用于统计
+  uint64_t markedBytes = 0;         // 本次GC标记或复制的字节数
+
+  std::vector<uint32_t> markStack;  // 已标记未扫描的record编码
+  bool markStackOverflow = false;
+  // 数组只入栈一次, 数目不超过指针数组的个数, 不会溢出
+  std::vector<PendingArray> pendingArraies;
 };
 
 }  // namespace gc
\ No newline at end of file
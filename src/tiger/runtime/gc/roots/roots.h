@@ -3,8 +3,11 @@
 
 #include <iostream>
 #include <map>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
+#include "tiger/frame/x64frame.h"
 #include "tiger/liveness/liveness.h"
 
 namespace gc {
@@ -22,11 +25,14 @@ struct PointerMap {
 
 class Roots {
  public:
+  /* labelLive为寄存器分配最后一轮活跃分析中每个label处活跃的temp */
   Roots(assem::InstrList *il_, frame::Frame *frame_, fg::FGraphPtr flowgraph,
-        std::vector<int> escapes_, temp::Map *color_)
+        std::vector<int> escapes_, temp::Map *color_,
+        const std::unordered_map<assem::Instr *, temp::TempList *> *labelLive)
       : escapes(escapes_),
         flowgraph_(flowgraph),
         color(color_),
+        label_live_(labelLive),
         il(il_),
         frame(frame_) {}
   ~Roots() = default;
@@ -34,23 +40,25 @@ class Roots {
   /* 生成.data段的pointermap */
   std::vector<PointerMap> GetPointerMaps() {
     GenerateAddressLiveMap();
-    GenerateTempLiveMap();
     BuildValidPointerMap();
     RewriteProgram();
     std::vector<PointerMap> pointerMaps;
     bool isMain = (frame->lable_->Name() == "tigermain");
 
-    for (auto pair : valid_address_map) {
+    /* 按指令顺序而不是Instr的地址顺序, 保证输出确定 */
+    for (assem::Instr *ins : il->GetList()) {
+      auto pair = valid_address_map.find(ins);
+      if (pair == valid_address_map.end()) continue;
       PointerMap newMap;
-      newMap.frameSize = frame->lable_->Name() + "_framesize";
+      newMap.frameSize = std::string(frame->lable_->Name()) + "_framesize";
       newMap.returnAddressLabel =
-          static_cast<assem::LabelInstr *>(pair.first)->label_->Name();
+          static_cast<assem::LabelInstr *>(pair->first)->label_->Name();
       newMap.label = "L" + newMap.returnAddressLabel;
       newMap.nextPointerMapLable = "0";
       if (isMain) newMap.isMain = "1";
 
       newMap.offsets = std::vector<std::string>();
-      for (int offset : pair.second)
+      for (int offset : pair->second)
         newMap.offsets.push_back(std::to_string(offset));
 
       pointerMaps.push_back(newMap);
@@ -70,9 +78,11 @@ class Roots {
   fg::FGraphPtr flowgraph_;
   std::vector<int> escapes;
   temp::Map *color;
-  std::map<fg::FNodePtr, temp::TempList *> temp_in_;
-  std::map<fg::FNodePtr, std::vector<int>> address_in_;
-  std::map<fg::FNodePtr, std::vector<int>> address_out_;
+  const std::unordered_map<assem::Instr *, temp::TempList *> *label_live_;
+  /* 存储指针的帧地址按offset升序编号, address_in_以FNode::Key()为下标 */
+  std::vector<int> slot_offset_;
+  std::unordered_map<int, int> slot_index_;
+  std::vector<bitset::BitSet> address_in_;
   std::map<assem::Instr *, std::vector<int>> valid_address_map;
   std::map<assem::Instr *, std::vector<std::string>> valid_temp_map;
 
@@ -131,52 +141,40 @@ class Roots {
     return std::vector<int>();
   }
 
-  /* 活跃的帧地址 */
+  /* 活跃的帧地址. 其他帧地址(int, static link, 入口保存的callee saves)
+   * 不是根, 只分析存储指针的帧地址 */
   void GenerateAddressLiveMap() {
-    std::list<fg::FNodePtr> flowgrapg_nodes = flowgraph_->Nodes()->GetList();
-    std::map<fg::FNodePtr, std::vector<int>> pre_in, pre_out;
-
-    for (fg::FNodePtr node_ : flowgrapg_nodes) {
-      address_in_[node_] = std::vector<int>();
-      address_out_[node_] = std::vector<int>();
+    /* 寄存器分配后frame中的全部位置(包括spill)都在Formals中 */
+    std::set<int> pointerSlots;
+    for (frame::Access *access : *frame->Formals())
+      if (typeid(*access) == typeid(frame::InFrameAccess) &&
+          static_cast<frame::InFrameAccess *>(access)->storePointer)
+        pointerSlots.insert(
+            static_cast<frame::InFrameAccess *>(access)->offset);
+    for (int offset : pointerSlots) {
+      slot_index_[offset] = (int)slot_offset_.size();
+      slot_offset_.push_back(offset);
     }
 
-    bool changed = false;
-    do {
-      pre_in = address_in_;
-      pre_out = address_out_;
-      changed = false;
-      for (fg::FNodePtr node_ : flowgrapg_nodes) {
-        assem::Instr *node_ins = node_->NodeInfo();
-        std::vector<int> use_list = AddressUse(node_ins);
-        std::vector<int> def_list = AddressDef(node_ins);
-
-        address_out_[node_] = std::vector<int>();
-        std::list<fg::FNodePtr> succ = node_->Succ()->GetList();
-        for (fg::FNodePtr succ_node : succ)
-          address_out_[node_] =
-              VectorUnion(address_out_[node_], address_in_[succ_node]);
-        address_in_[node_] = VectorUnion(
-            VectorDifference(address_out_[node_], def_list), use_list);
-        //判断该点的in和out有无变化
-        if (address_out_[node_] != pre_out[node_] ||
-            address_in_[node_] != pre_in[node_])
-          changed = true;
+    int slot_num = (int)slot_offset_.size();
+    int node_num = flowgraph_->nodecount_;
+    std::vector<bitset::BitSet> node_use(node_num, bitset::BitSet(slot_num));
+    std::vector<bitset::BitSet> node_def(node_num, bitset::BitSet(slot_num));
+    address_in_.assign(node_num, bitset::BitSet(slot_num));
+    for (fg::FNodePtr node_ : flowgraph_->Nodes()->GetList()) {
+      assem::Instr *node_ins = node_->NodeInfo();
+      for (int offset : AddressUse(node_ins)) {
+        auto it = slot_index_.find(offset);
+        if (it != slot_index_.end()) node_use[node_->Key()].Set(it->second);
+      }
+      for (int offset : AddressDef(node_ins)) {
+        auto it = slot_index_.find(offset);
+        if (it != slot_index_.end()) node_def[node_->Key()].Set(it->second);
       }
-    } while (changed);
-  }
-
-  /* 活跃的寄存器 */
-  void GenerateTempLiveMap() {
-    live::LiveGraphFactory *liveGraphFacPtr =
-        new live::LiveGraphFactory(flowgraph_);
-    liveGraphFacPtr->LiveMap();
-    graph::Table<assem::Instr, temp::TempList> *in_ =
-        liveGraphFacPtr->in_.get();
-    std::list<fg::FNodePtr> flowgrapg_nodes = flowgraph_->Nodes()->GetList();
-    for (fg::FNodePtr node_ : flowgrapg_nodes) {
-      temp_in_[node_] = in_->Look(node_);
     }
+
+    live::BlockSolver solver(flowgraph_, slot_num, node_use, node_def);
+    solver.Solve(&address_in_, nullptr);
   }
 
   /* call之后活跃的callee saved和帧地址 */
@@ -196,11 +194,14 @@ class Roots {
       }
       if (nextReturnLabel) {
         nextReturnLabel = false;
-        //存储指针的帧地址
-        valid_address_map[ins] = address_in_[node_];
+        valid_address_map[ins] = std::vector<int>();
+        address_in_[node_->Key()].ForEach([&](int slot) {
+          valid_address_map[ins].push_back(slot_offset_[slot]);
+        });
         //筛选出存储指针的callee saves寄存器
         valid_temp_map[ins] = std::vector<std::string>();
-        for (auto temp : temp_in_[node_]->GetList())
+        if (!label_live_) continue;
+        for (auto temp : label_live_->at(ins)->GetList())
           if (temp->storePointer) {
             std::string regName = *color->Look(temp);
             if (std::find(calleeSaved.begin(), calleeSaved.end(), regName) !=
@@ -236,12 +237,20 @@ class Roots {
           frame::Access *access = frame->AllocLocal(true);
           access->setStorePointer();
           valid_address_map[(*labelnode)].push_back(offset);
-          std::string ass = "movq " + reg + ", (" + frame->lable_->Name() +
-                            "_framesize" + std::to_string(offset) + ")(%rsp)";
+          std::string ass = "movq " + reg + ", (" +
+                            std::string(frame->lable_->Name()) + "_framesize" +
+                            std::to_string(offset) + ")(%rsp)";
           assem::Instr *save_pointer =
               new assem::OperInstr(ass, nullptr, nullptr, nullptr);
           iter = ins_list.insert(iter, save_pointer);  // iter指向save_pointer
           iter++;                                      // iter指向call
+          // call返回后从栈中取回, 移动对象的GC会更新栈中的指针
+          std::string reload = "movq (" + std::string(frame->lable_->Name()) +
+                               "_framesize" + std::to_string(offset) +
+                               ")(%rsp), " + reg;
+          ins_list.insert(std::next(labelnode), new assem::OperInstr(
+                                                    reload, nullptr, nullptr,
+                                                    nullptr));
         }
       }
       iter++;
@@ -249,24 +258,6 @@ class Roots {
     il = new assem::InstrList();
     for (auto ins : ins_list) il->Append(ins);
   }
-
-  std::vector<int> VectorUnion(std::vector<int> vec1, std::vector<int> vec2) {
-    std::vector<int> result;
-    std::sort(vec1.begin(), vec1.end());
-    std::sort(vec2.begin(), vec2.end());
-    std::set_union(vec1.begin(), vec1.end(), vec2.begin(), vec2.end(),
-                   std::back_inserter(result));
-    return result;
-  }
-
-  std::vector<int> VectorDifference(std::vector<int> vec1,
-                                    std::vector<int> vec2) {
-    std::vector<int> result;
-    for (int item : vec1)
-      if (std::find(vec2.begin(), vec2.end(), item) == vec2.end())
-        result.push_back(item);
-    return result;
-  }
 };
 
 }  // namespace gc
@@ -4,12 +4,20 @@
 
 extern int tigermain();
 
+// written by the write barrier in generated code, size must match
+// gc::CARD_TABLE_SIZE in gc/barrier/barrier.h
+unsigned char tiger_card_table[65536];
+// the inline allocation buffer is always empty, so every record is
+// allocated by alloc_record (see gc/alloc/alloc.h)
+char *tiger_alloc_ptr = 0;
+char *tiger_alloc_limit = 0;
+
 // seven arguments testcase
 int sum_seven(int v1, int v2, int v3, int v4, int v5, int v6, int v7) {
   return v1 + v2 + v3 + v4 + v5 + v6 + v7;
 }
 
-long *init_array(int size, long init) {
+long *init_array(int size, long init, int has_pointers) {
   int i;
   long *a = (long *)malloc(size * sizeof(long));
   for (i = 0; i < size; i++) a[i] = init;
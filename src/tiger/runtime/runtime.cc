@@ -4,14 +4,22 @@
 // Note: change to header file of your implemnted heap!
 #include <iostream>
 
+#include "gc/alloc/fill.h"
 #include "gc/heap/heap.h"
 #ifndef EXTERNC
 #define EXTERNC extern "C"
 #endif
 
 #define TIGER_HEAP_SIZE (1 << 20)
+#define TIGER_HEAP_MAX_SIZE (1ull << 30)
+#define TIGER_HEAP_OCCUPANCY 50
 EXTERNC int tigermain(int);
 gc::TigerHeap *tiger_heap = nullptr;
+// 生成代码中的写屏障标记这里的card
+unsigned char tiger_card_table[gc::CARD_TABLE_SIZE];
+// 生成代码内联分配record的缓冲区, 由heap维护
+char *tiger_alloc_ptr = nullptr;
+char *tiger_alloc_limit = nullptr;
 
 #define CHECK_HEAP                                                 \
   do {                                                             \
@@ -36,6 +44,14 @@ gc::TigerHeap *tiger_heap = nullptr;
 //   sp = ((uint64_t *)((*(uint64_t *)rbp) + 2 * sizeof(uint64_t))); \
 //   } while (0)
 
+#define CHECK_ALLOC(ptr)                                 \
+  do {                                             \
+    if (!(ptr)) {                                  \
+      fprintf(stderr, "tiger: out of memory\n"); \
+      exit(1);                                     \
+    }                                              \
+  } while (0)
+
 // Global interface & heap object to expose to runtime.c
 EXTERNC char *Alloc(uint64_t size) {
   CHECK_HEAP;
@@ -56,18 +72,26 @@ EXTERNC uint64_t MaxFree() {
   return tiger_heap->MaxFree();
 }
 
-EXTERNC long *init_array(int size, long init) {
+// has_pointers: 元素类型为record, 数组或string, 由编译器传入
+EXTERNC long *init_array(int size, long init, int has_pointers) {
   uint64_t *sp;  // sp为alloc_record的RBP
   GET_RBP(sp);
   sp += 2;
-  int i;
   uint64_t allocate_size = size * sizeof(long);
-  long *a = (long *)tiger_heap->AllocateArray(allocate_size,sp);
+  bool zeroed;
+  // init可能指向heap中的对象, GC后需要更新
+  if (has_pointers) tiger_heap->PushRoot(&init);
+  long *a = (long *)tiger_heap->AllocateArray(allocate_size, sp, &zeroed,
+                                              has_pointers);
   if (!a) {
     tiger_heap->GC();
-    a = (long *)tiger_heap->AllocateArray(allocate_size,sp);
+    a = (long *)tiger_heap->AllocateArray(allocate_size, sp, &zeroed,
+                                          has_pointers);
+    CHECK_ALLOC(a);
   }
-  for (i = 0; i < size; i++) a[i] = init;
+  if (has_pointers) tiger_heap->PopRoots(1);
+  // 从未写过的内存已经是0
+  if (init != 0 || !zeroed) gc::FillWords((uint64_t *)a, init, size);
   return a;
 }
 
@@ -76,45 +100,121 @@ struct string {
   unsigned char chars[1];
 };
 
+/* concat得到的较长的string. length字段为STRING_BUILDER_TAG, 以区别于
+ * struct string, 内容位于多个builder共享的buffer中. buffer只在末尾追加,
+ * buffer->length为已写入的长度; 长度与之相等的builder可以原地追加,
+ * 因此s := concat(s, ...)的循环中每次追加均摊O(1).
+ * builder是heap中的record, 其descriptor为string_builder_descriptor */
+struct string_builder {
+  int tag;
+  int length;
+  struct string *buffer;
+  long capacity;
+};
+
+#define STRING_BUILDER_TAG (-1)
+// 结果至少有这么长时concat才返回builder, 短的string直接拷贝
+#define STRING_BUILDER_MIN 64
+static unsigned char string_builder_descriptor[] = "010";
+
+static inline bool IsBuilder(struct string *s) {
+  return s->length == STRING_BUILDER_TAG;
+}
+
+static inline int StringLength(struct string *s) {
+  return IsBuilder(s) ? ((struct string_builder *)s)->length : s->length;
+}
+
+static inline unsigned char *StringChars(struct string *s) {
+  return IsBuilder(s) ? ((struct string_builder *)s)->buffer->chars
+                      : s->chars;
+}
+
 EXTERNC int *alloc_record(int size, struct string *des_ptr) {
   uint64_t *sp;  // sp为alloc_record的RBP
   GET_RBP(sp);
   sp += 2;
-  int i;
-  int *p, *a;
-  p = a = (int *)tiger_heap->AllocateRecord(size, des_ptr->length,
-                                            des_ptr->chars, sp);
-  if (!p) {
+  int *a = (int *)tiger_heap->AllocateRecord(size, des_ptr->length,
+                                             des_ptr->chars, sp);
+  if (!a) {
     tiger_heap->GC();
-    p = a = (int *)tiger_heap->AllocateRecord(size, des_ptr->length,
-                                              des_ptr->chars, sp);
+    a = (int *)tiger_heap->AllocateRecord(size, des_ptr->length,
+                                          des_ptr->chars, sp);
+    CHECK_ALLOC(a);
   }
-  for (i = 0; i < size; i += sizeof(int)) *p++ = 0;
+  // record的大小是字的整数倍
+  uint64_t *p = (uint64_t *)a;
+  for (int i = 0; i < size / 8; i++) p[i] = 0;
   return a;
 }
 
 EXTERNC int string_equal(struct string *s, struct string *t) {
-  int i;
   if (s == t) return 1;
-  if (s->length != t->length) return 0;
-  for (i = 0; i < s->length; i++)
-    if (s->chars[i] != t->chars[i]) return 0;
-  return 1;
+  int length = StringLength(s);
+  if (length != StringLength(t)) return 0;
+  return !memcmp(StringChars(s), StringChars(t), length);
+}
+
+/* print和printi先写入私有的缓冲区, 满了或flush()/读输入/退出时
+ * 整块fwrite到stdout, 避免每个字符一次stdio调用和加锁.
+ * runtime向stdout输出错误信息前也要先FlushOutput保持顺序 */
+#define OUTPUT_BUFFER_SIZE (1 << 16)
+static char output_buffer[OUTPUT_BUFFER_SIZE];
+static int output_used = 0;
+
+static void FlushOutput() {
+  if (output_used) fwrite(output_buffer, 1, output_used, stdout);
+  output_used = 0;
+}
+
+static inline void WriteOutput(const void *data, int n) {
+  if (n > OUTPUT_BUFFER_SIZE - output_used) {
+    FlushOutput();
+    if (n >= OUTPUT_BUFFER_SIZE) {  // 大块直接写出, 不经过缓冲区
+      fwrite(data, 1, n, stdout);
+      return;
+    }
+  }
+  memcpy(output_buffer + output_used, data, n);
+  output_used += n;
 }
 
 EXTERNC void print(struct string *s) {
-  int i;
-  unsigned char *p = s->chars;
-  for (i = 0; i < s->length; i++, p++) putchar(*p);
+  WriteOutput(StringChars(s), StringLength(s));
 }
 
-EXTERNC void printi(int k) { printf("%d", k); }
+EXTERNC void printi(int k) {
+  char digits[12];  // "-2147483648"
+  char *p = digits + sizeof(digits);
+  unsigned int value = k < 0 ? 0u - (unsigned int)k : k;
+  do {
+    *--p = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  if (k < 0) *--p = '-';
+  WriteOutput(p, digits + sizeof(digits) - p);
+}
 
-EXTERNC void flush() { fflush(stdout); }
+EXTERNC void flush() {
+  FlushOutput();
+  fflush(stdout);
+}
 
 struct string consts[256];
 struct string empty = {0, ""};
 
+// Byte count with an optional K, M or G suffix, e.g. TIGER_HEAP_MAX=512M
+static uint64_t EnvSize(const char *name, uint64_t fallback) {
+  const char *value = getenv(name);
+  if (!value || !*value) return fallback;
+  char *end;
+  uint64_t size = strtoull(value, &end, 10);
+  if (*end == 'K' || *end == 'k') size <<= 10;
+  if (*end == 'M' || *end == 'm') size <<= 20;
+  if (*end == 'G' || *end == 'g') size <<= 30;
+  return size ? size : fallback;
+}
+
 int main() {
   int i;
   for (i = 0; i < 256; i++) {
@@ -124,60 +224,150 @@ int main() {
   // Change it to your own implementation after implement heap and delete the
   // comment!
   tiger_heap = new gc::TigerHeap();
-  tiger_heap->Initialize(TIGER_HEAP_SIZE);
+  // TIGER_GC=copying selects the semispace copying collector,
+  // TIGER_GC=generational the nursery + mark-sweep old generation
+  const char *gc_mode = getenv("TIGER_GC");
+  gc::TigerHeap::Mode mode = gc::TigerHeap::MARK_SWEEP;
+  if (gc_mode && !strcmp(gc_mode, "copying")) mode = gc::TigerHeap::COPYING;
+  if (gc_mode && !strcmp(gc_mode, "generational"))
+    mode = gc::TigerHeap::GENERATIONAL;
+  // The heap starts at TIGER_HEAP_INITIAL and grows up to TIGER_HEAP_MAX,
+  // keeping live data near TIGER_HEAP_OCCUPANCY percent after each GC
+  uint64_t initial = EnvSize("TIGER_HEAP_INITIAL", TIGER_HEAP_SIZE);
+  uint64_t max = EnvSize("TIGER_HEAP_MAX", TIGER_HEAP_MAX_SIZE);
+  const char *occupancy_env = getenv("TIGER_HEAP_OCCUPANCY");
+  int occupancy = occupancy_env ? atoi(occupancy_env) : TIGER_HEAP_OCCUPANCY;
+  if (occupancy <= 0 || occupancy > 100) occupancy = TIGER_HEAP_OCCUPANCY;
+  tiger_heap->Initialize(initial, mode, max, occupancy / 100.0);
+  // TIGER_GC_STATS=1 prints GC statistics to stderr at exit,
+  // TIGER_GC_TRACE=<file> also writes every collection as JSON
+  const char *stats = getenv("TIGER_GC_STATS");
+  const char *trace = getenv("TIGER_GC_TRACE");
+  if ((stats && *stats && strcmp(stats, "0")) || (trace && *trace)) {
+    tiger_heap->EnableStats(trace && *trace ? trace : nullptr);
+    atexit([] { tiger_heap->ReportStats(); });
+  }
+  // exit时先于stdio写出print的缓冲区
+  atexit(FlushOutput);
   return tigermain(0 /* static link */);
 }
 
 EXTERNC int ord(struct string *s) {
-  if (s->length == 0)
+  if (StringLength(s) == 0)
     return -1;
   else
-    return s->chars[0];
+    return StringChars(s)[0];
 }
 
 EXTERNC struct string *chr(int i) {
   if (i < 0 || i >= 256) {
+    FlushOutput();
     printf("chr(%d) out of range\n", i);
     exit(1);
   }
   return consts + i;
 }
 
-EXTERNC int size(struct string *s) { return s->length; }
+EXTERNC int size(struct string *s) { return StringLength(s); }
+
+/* 在heap中分配可容纳capacity个字符的string, 作为不含指针的数组.
+ * 可能GC, 调用者须先用PushRoot登记之后还要用到的heap指针 */
+static struct string *AllocString(long capacity, uint64_t *sp) {
+  uint64_t allocate_size = sizeof(int) + capacity;
+  struct string *t =
+      (struct string *)tiger_heap->AllocateArray(allocate_size, sp);
+  if (!t) {
+    tiger_heap->GC();
+    t = (struct string *)tiger_heap->AllocateArray(allocate_size, sp);
+    CHECK_ALLOC(t);
+  }
+  return t;
+}
+
+/* 分配引用buffer前length个字符的builder */
+static struct string *NewBuilder(struct string *buffer, int length,
+                                 long capacity, uint64_t *sp) {
+  uint64_t allocate_size = sizeof(struct string_builder);
+  tiger_heap->PushRoot(&buffer);
+  struct string_builder *t =
+      (struct string_builder *)tiger_heap->AllocateRecord(
+          allocate_size, 3, string_builder_descriptor, sp);
+  if (!t) {
+    tiger_heap->GC();
+    t = (struct string_builder *)tiger_heap->AllocateRecord(
+        allocate_size, 3, string_builder_descriptor, sp);
+    CHECK_ALLOC(t);
+  }
+  tiger_heap->PopRoots(1);
+  t->tag = STRING_BUILDER_TAG;
+  t->length = length;
+  t->buffer = buffer;
+  t->capacity = capacity;
+  return (struct string *)t;
+}
 
 EXTERNC struct string *substring(struct string *s, int first, int n) {
-  if (first < 0 || first + n > s->length) {
-    printf("substring([%d],%d,%d) out of range\n", s->length, first, n);
+  uint64_t *sp;  // sp为substring的RBP
+  GET_RBP(sp);
+  sp += 2;
+  if (first < 0 || n < 0 || first + n > StringLength(s)) {
+    FlushOutput();
+    printf("substring([%d],%d,%d) out of range\n", StringLength(s), first,
+           n);
     exit(1);
   }
-  if (n == 1) return consts + s->chars[first];
-  {
-    struct string *t = (struct string *)malloc(sizeof(int) + n);
-    int i;
-    t->length = n;
-    for (i = 0; i < n; i++) t->chars[i] = s->chars[first + i];
-    return t;
-  }
+  if (n == 0) return &empty;
+  if (n == 1) return consts + StringChars(s)[first];
+  tiger_heap->PushRoot(&s);
+  struct string *t = AllocString(n, sp);
+  tiger_heap->PopRoots(1);
+  t->length = n;
+  memcpy(t->chars, StringChars(s) + first, n);
+  return t;
 }
 
 EXTERNC struct string *concat(struct string *a, struct string *b) {
-  if (a->length == 0)
-    return b;
-  else if (b->length == 0)
-    return a;
-  else {
-    int i, n = a->length + b->length;
-    struct string *t = (struct string *)malloc(sizeof(int) + n);
-    t->length = n;
-    for (i = 0; i < a->length; i++) t->chars[i] = a->chars[i];
-    for (i = 0; i < b->length; i++) t->chars[i + a->length] = b->chars[i];
-    return t;
+  uint64_t *sp;  // sp为concat的RBP
+  GET_RBP(sp);
+  sp += 2;
+  int alen = StringLength(a), blen = StringLength(b);
+  if (alen == 0) return b;
+  if (blen == 0) return a;
+  long n = (long)alen + blen;
+  if (n > INT32_MAX) {
+    FlushOutput();
+    printf("concat: string too long\n");
+    exit(1);
   }
+
+  // a是buffer中最长的builder且空间足够: 原地追加
+  if (IsBuilder(a)) {
+    struct string_builder *builder = (struct string_builder *)a;
+    if (builder->buffer->length == alen && n <= builder->capacity) {
+      memcpy(builder->buffer->chars + alen, StringChars(b), blen);
+      builder->buffer->length = n;
+      return NewBuilder(builder->buffer, n, builder->capacity, sp);
+    }
+  }
+
+  tiger_heap->PushRoot(&a);
+  tiger_heap->PushRoot(&b);
+  bool grow = IsBuilder(a) || n >= STRING_BUILDER_MIN;
+  long capacity = grow ? 2 * n : n;
+  if (capacity > INT32_MAX) capacity = INT32_MAX;
+  struct string *t = AllocString(capacity, sp);
+  tiger_heap->PopRoots(2);
+  t->length = n;
+  memcpy(t->chars, StringChars(a), alen);
+  memcpy(t->chars + alen, StringChars(b), blen);
+  if (!grow) return t;
+  return NewBuilder(t, n, capacity, sp);
 }
 
 #undef getchar
 
 EXTERNC struct string *__wrap_getchar() {
+  FlushOutput();  // 交互时先输出提示
   int i = getc(stdin);
   if (i == EOF)
     return &empty;
@@ -15,7 +15,7 @@ type::Ty *SimpleVar::SemAnalyze(env::VEnvPtr venv, env::TEnvPtr tenv,
   if (entry && typeid(*entry) == typeid(env::VarEntry))
     return (static_cast<env::VarEntry *>(entry))->ty_->ActualTy();
 
-  errormsg->Error(pos_, "undefined variable %s", sym_->Name().c_str());
+  errormsg->Error(pos_, "undefined variable %s", sym_->Name().data());
   return type::IntTy::Instance();
 }
 
@@ -33,7 +33,7 @@ type::Ty *FieldVar::SemAnalyze(env::VEnvPtr venv, env::TEnvPtr tenv,
   for (const type::Field *field : fieldsList)
     if (field->name_->Name() == sym_->Name()) return field->ty_;
 
-  errormsg->Error(pos_, "field %s doesn't exist", sym_->Name().c_str());
+  errormsg->Error(pos_, "field %s doesn't exist", sym_->Name().data());
 
   return type::VoidTy::Instance();
 }
@@ -89,7 +89,7 @@ type::Ty *CallExp::SemAnalyze(env::VEnvPtr venv, env::TEnvPtr tenv,
   env::EnvEntry *entry = venv->Look(func_);
 
   if (!entry || typeid(*entry) != typeid(env::FunEntry)) {
-    errormsg->Error(pos_, "undefined function %s", func_->Name().c_str());
+    errormsg->Error(pos_, "undefined function %s", func_->Name().data());
     return type::IntTy::Instance();
   }
 
@@ -111,11 +111,11 @@ type::Ty *CallExp::SemAnalyze(env::VEnvPtr venv, env::TEnvPtr tenv,
       exp_list.pop_front();
     }
     errormsg->Error(pos_, "too little params in function %s",
-                    func_->Name().c_str());
+                    func_->Name().data());
     return type::IntTy::Instance();
   } else if (ty_list.size() < exp_list.size()) {
     errormsg->Error(pos_, "too many params in function %s",
-                    func_->Name().c_str());
+                    func_->Name().data());
     return type::IntTy::Instance();
   }
 
@@ -184,7 +184,7 @@ type::Ty *RecordExp::SemAnalyze(env::VEnvPtr venv, env::TEnvPtr tenv,
   type::Ty *type_pointer = tenv->Look(typ_);
 
   if (!type_pointer) {
-    errormsg->Error(pos_, "undefined type %s", this->typ_->Name().c_str());
+    errormsg->Error(pos_, "undefined type %s", this->typ_->Name().data());
     return type::VoidTy::Instance();
   }
   return type_pointer;
@@ -317,11 +317,11 @@ type::Ty *ArrayExp::SemAnalyze(env::VEnvPtr venv, env::TEnvPtr tenv,
       init_->SemAnalyze(venv, tenv, labelcount, errormsg)->ActualTy();
 
   if (!typ_type_pointer) {
-    errormsg->Error(pos_, "undifined type %s", typ_->Name().c_str());
+    errormsg->Error(pos_, "undifined type %s", typ_->Name().data());
     return type::VoidTy::Instance();
   }
   if (typeid(*typ_type_pointer) != typeid(type::ArrayTy)) {
-    errormsg->Error(pos_, "not array type %s", typ_->Name().c_str());
+    errormsg->Error(pos_, "not array type %s", typ_->Name().data());
     return type::VoidTy::Instance();
   }
   if (typeid(*size_type_pointer) != typeid(type::IntTy)) {
@@ -357,7 +357,7 @@ void FunctionDec::SemAnalyze(env::VEnvPtr venv, env::TEnvPtr tenv,
     for (const Field *field : field_list) {
       type::Ty *type_temp = tenv->Look(field->typ_);
       if (!type_temp) {
-        errormsg->Error(pos_, "undefined type %s", field->typ_->Name().c_str());
+        errormsg->Error(pos_, "undefined type %s", field->typ_->Name().data());
         continue;
       } else
         param_type->Append(type_temp);
@@ -452,7 +452,7 @@ type::Ty *RecordTy::SemAnalyze(env::TEnvPtr tenv,
   for (const Field *field : field_list) {
     type::Ty *type_field = tenv->Look(field->typ_);
     if (!type_field) {
-      errormsg->Error(pos_, "undefined type %s", field->typ_->Name().c_str());
+      errormsg->Error(pos_, "undefined type %s", field->typ_->Name().data());
       fields->Append(new type::Field(field->name_, type::IntTy::Instance()));
     } else
       fields->Append(new type::Field(field->name_, type_field));
@@ -464,7 +464,7 @@ type::Ty *ArrayTy::SemAnalyze(env::TEnvPtr tenv,
                               err::ErrorMsg *errormsg) const {
   type::Ty *array_type = tenv->Look(array_);
   if (!array_type) {
-    errormsg->Error(pos_, "undefined type %s", array_->Name().c_str());
+    errormsg->Error(pos_, "undefined type %s", array_->Name().data());
     return type::VoidTy::Instance();
   }
   return new type::ArrayTy(array_type);
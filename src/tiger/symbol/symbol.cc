@@ -1,30 +1,85 @@
 #include "tiger/symbol/symbol.h"
 
-namespace {
+#include <cstring>
+#include <mutex>
+#include <vector>
 
-constexpr unsigned int HASH_TABSIZE = 109;
-sym::Symbol *hashtable[HASH_TABSIZE];
+namespace sym {
 
-unsigned int Hash(std::string_view str) {
-  unsigned int h = 0;
-  for (const char *s = str.data(); *s; s++)
-    h = h * 65599 + *s;
-  return h;
-}
+/**
+ * Symbol table split into shards by hash, each with its own lock, arena and
+ * open-addressing index, so back-end threads creating labels rarely wait
+ * for each other. Names are copied into the shard's arena next to each
+ * other.
+ */
+class Interner {
+public:
+  static constexpr size_t kShards = 16;
 
-} // namespace
+  static Interner &Get() {
+    // 不析构, 符号在退出前一直有效
+    static Interner *interner = new Interner();
+    return *interner;
+  }
 
-namespace sym {
+  Symbol *Intern(std::string_view name) {
+    size_t hash = Hash(name);
+    Shard &shard = shards_[hash % kShards];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    size_t i = shard.Find(name, hash);
+    if (shard.slots[i])
+      return shard.slots[i];
+
+    arena::Scope scope(&shard.arena);
+    char *str = static_cast<char *>(shard.arena.Allocate(name.size() + 1, 1));
+    memcpy(str, name.data(), name.size());
+    str[name.size()] = '\0';
+    Symbol *sym = new Symbol(std::string_view(str, name.size()), hash);
+    shard.slots[i] = sym;
+    if (++shard.count * 2 > shard.slots.size())
+      shard.Grow();
+    return sym;
+  }
+
+private:
+  struct Shard {
+    std::mutex mutex;
+    arena::Arena arena;
+    std::vector<Symbol *> slots = std::vector<Symbol *>(64);
+    size_t count = 0;
+
+    // Slot of the symbol named `name`, or the empty slot where it would go
+    size_t Find(std::string_view name, size_t hash) const {
+      size_t mask = slots.size() - 1;
+      size_t i = (hash / kShards) & mask;
+      while (slots[i] &&
+             (slots[i]->hash_ != hash || slots[i]->Name() != name))
+        i = (i + 1) & mask;
+      return i;
+    }
+
+    void Grow() {
+      std::vector<Symbol *> old(slots.size() * 2);
+      old.swap(slots);
+      for (Symbol *sym : old)
+        if (sym)
+          slots[Find(sym->Name(), sym->hash_)] = sym;
+    }
+  };
+
+  static size_t Hash(std::string_view str) {
+    // FNV-1a
+    size_t h = 14695981039346656037ull;
+    for (char c : str)
+      h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    return h;
+  }
+
+  Shard shards_[kShards];
+};
 
 Symbol *Symbol::UniqueSymbol(std::string_view name) {
-  unsigned int index = Hash(name) % HASH_TABSIZE;
-  Symbol *syms = hashtable[index], *sym;
-  for (sym = syms; sym; sym = sym->next_)
-    if (sym->name_ == name)
-      return sym;
-  sym = new Symbol(static_cast<std::string>(name), syms);
-  hashtable[index] = sym;
-  return sym;
+  return Interner::Get().Intern(name);
 }
 
 } // namespace sym
@@ -2,7 +2,9 @@
 #define TIGER_SYMBOL_SYMBOL_H_
 
 #include <string>
+#include <string_view>
 
+#include "tiger/util/arena.h"
 #include "tiger/util/table.h"
 
 /**
@@ -16,21 +18,27 @@ class Ty;
 } // namespace type
 
 namespace sym {
-class Symbol {
+/**
+ * Interned identifier or label. Symbols and their names are allocated once
+ * and never freed, equal names give the same Symbol.
+ */
+class Symbol : public arena::ArenaObject<Symbol> {
   template <typename ValueType> friend class Table;
+  friend class Interner;
 
 public:
+  // Safe to call from several threads at once
   static Symbol *UniqueSymbol(std::string_view);
-  [[nodiscard]] std::string Name() const { 
-    assert(name_);
-    return name_; }
+  // The name is NUL-terminated, Name().data() can be passed to printf
+  [[nodiscard]] std::string_view Name() const { return {name_, length_}; }
 
 private:
-  Symbol(std::string name, Symbol *next)
-      : name_(std::move(name)), next_(next) {}
+  Symbol(std::string_view name, size_t hash)
+      : name_(name.data()), length_(name.size()), hash_(hash) {}
 
-  std::string name_;
-  Symbol *next_;
+  const char *name_;
+  size_t length_;
+  size_t hash_;
 };
 
 template <typename ValueType>
@@ -41,7 +49,7 @@ public:
   void EndScope();
 
 private:
-  Symbol marksym_ = {"<mark>", nullptr};
+  Symbol marksym_ = {"<mark>", 0};
 };
 
 template <typename ValueType> void Table<ValueType>::BeginScope() {
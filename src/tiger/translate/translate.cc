@@ -1,5 +1,7 @@
 #include "tiger/translate/translate.h"
 
+#include "tiger/runtime/gc/alloc/alloc.h"
+
 extern frame::Frags *frags;
 extern frame::RegManager *reg_manager;
 extern std::vector<std::string> functions_ret_ptr;
@@ -114,18 +116,27 @@ void ProgTr::Translate() {
 namespace absyn {
 /********** GC Protocol **********/
 
+/* record, 数组和string都是heap中的对象, string中不含指针,
+ * 字符串常量不在heap中, GC会忽略指向heap以外的指针 */
+bool IsPointer(type::Ty *ty_) {
+  return typeid(*(ty_->ActualTy())) == typeid(type::RecordTy) ||
+         typeid(*(ty_->ActualTy())) == typeid(type::ArrayTy) ||
+         typeid(*(ty_->ActualTy())) == typeid(type::StringTy);
+}
+
 /*Put record descriptor into stringFrag
  * Structure: "$010101$"
  * LableName: "$typeName$_DESCRIPTOR"
+ * 内联分配的record带一个头部字, 其descriptor为"0$010101$",
+ * LableName: "$typeName$_HEADER_DESCRIPTOR"
  */
 void emitRecordRecordTypeDescriptor(type::RecordTy *recordTy,
                                     sym::Symbol *name) {
   std::string pointMAP, recordNAME;
-  recordNAME = name->Name() + "_DESCRIPTOR";
+  recordNAME = std::string(name->Name()) + "_DESCRIPTOR";
   std::list<type::Field *> field_list = recordTy->fields_->GetList();
   for (const type::Field *field : field_list) {
-    if (typeid(*field->ty_->ActualTy()) == typeid(type::RecordTy) ||
-        typeid(*field->ty_->ActualTy()) == typeid(type::ArrayTy))
+    if (IsPointer(field->ty_))
       pointMAP += "1";
     else
       pointMAP += "0";
@@ -134,11 +145,10 @@ void emitRecordRecordTypeDescriptor(type::RecordTy *recordTy,
   temp::Label *str_lable = temp::LabelFactory::NamedLabel(recordNAME);
   frame::StringFrag *str_frag = new frame::StringFrag(str_lable, pointMAP);
   frags->PushBack(str_frag);
-}
 
-bool IsPointer(type::Ty *ty_) {
-  return typeid(*(ty_->ActualTy())) == typeid(type::RecordTy) ||
-         typeid(*(ty_->ActualTy())) == typeid(type::ArrayTy);
+  temp::Label *header_lable = temp::LabelFactory::NamedLabel(
+      std::string(name->Name()) + gc::HEADER_DESCRIPTOR_SUFFIX);
+  frags->PushBack(new frame::StringFrag(header_lable, "0" + pointMAP));
 }
 
 /********** END GC Protocol **********/
@@ -164,7 +174,7 @@ tr::ExpAndTy *SimpleVar::Translate(env::VEnvPtr venv, env::TEnvPtr tenv,
         trans_res, static_cast<env::VarEntry *>(entry)->ty_->ActualTy());
   }
 
-  errormsg->Error(pos_, "undefined variable %s", sym_->Name().c_str());
+  errormsg->Error(pos_, "undefined variable %s", sym_->Name().data());
   return new tr::ExpAndTy(nullptr, type::IntTy::Instance());
 }
 
@@ -188,7 +198,7 @@ tr::ExpAndTy *FieldVar::Translate(env::VEnvPtr venv, env::TEnvPtr tenv,
     pos++;
   }
 
-  errormsg->Error(pos_, "field %s doesn't exist", sym_->Name().c_str());
+  errormsg->Error(pos_, "field %s doesn't exist", sym_->Name().data());
   return new tr::ExpAndTy(nullptr, type::IntTy::Instance());
 }
 
@@ -412,6 +422,7 @@ tr::ExpAndTy *RecordExp::Translate(env::VEnvPtr venv, env::TEnvPtr tenv,
                                    err::ErrorMsg *errormsg) const {
   type::Ty *type_pointer = tenv->Look(typ_)->ActualTy();
   tree::ExpList *field_exp_ = new tree::ExpList();
+  std::vector<bool> field_pointer;
   std::list<absyn::EField *> efields = fields_->GetList();
 
   for (auto efield_iter = efields.begin(); efield_iter != efields.end();
@@ -419,32 +430,101 @@ tr::ExpAndTy *RecordExp::Translate(env::VEnvPtr venv, env::TEnvPtr tenv,
     tr::ExpAndTy *field_ele_trans =
         (*efield_iter)->exp_->Translate(venv, tenv, level, label, errormsg);
     field_exp_->Append(field_ele_trans->exp_->UnEx());
+    // For GC, 只有指针字段的初始化需要写屏障
+    bool pointer = false;
+    for (type::Field *field :
+         static_cast<type::RecordTy *>(type_pointer)->fields_->GetList())
+      if (field->name_ == (*efield_iter)->name_)
+        pointer = IsPointer(field->ty_);
+    field_pointer.push_back(pointer);
   }
 
-  /* Alloc record */
+  /* Alloc record: 在内联分配缓冲区中bump分配并清零字段,
+   * 缓冲区不够时调用alloc_record(可能GC), 协议见gc/alloc/alloc.h */
   temp::Temp *record_add_reg = temp::TempFactory::NewTemp();
+  temp::Temp *object_reg = temp::TempFactory::NewTemp();
+  temp::Temp *end_reg = temp::TempFactory::NewTemp();
+  int record_size = efields.size() * reg_manager->WordSize();
+  temp::Label *fast_label = temp::LabelFactory::NewLabel();
+  temp::Label *slow_label = temp::LabelFactory::NewLabel();
+  temp::Label *meet_point = temp::LabelFactory::NewLabel();
+  temp::Label *alloc_ptr = temp::LabelFactory::NamedLabel(gc::ALLOC_PTR_SYMBOL);
+  temp::Label *alloc_limit =
+      temp::LabelFactory::NamedLabel(gc::ALLOC_LIMIT_SYMBOL);
+
   tree::ExpList *record_size_const = new tree::ExpList();
-  record_size_const->Append(
-      new tree::ConstExp(efields.size() * reg_manager->WordSize()));
-  record_size_const->Append(new tree::NameExp(
-      temp::LabelFactory::NamedLabel(typ_->Name() + "_DESCRIPTOR")));
-  tree::Stm *alloca_record = new tree::MoveStm(
-      new tree::TempExp(record_add_reg),
-      new tree::CallExp(
-          new tree::NameExp(temp::LabelFactory::NamedLabel("alloc_record")),
-          record_size_const));
+  record_size_const->Append(new tree::ConstExp(record_size));
+  record_size_const->Append(new tree::NameExp(temp::LabelFactory::NamedLabel(
+      std::string(typ_->Name()) + "_DESCRIPTOR")));
+  tree::Stm *slow_path = new tree::SeqStm(
+      new tree::LabelStm(slow_label),
+      new tree::MoveStm(
+          new tree::TempExp(record_add_reg),
+          new tree::CallExp(
+              new tree::NameExp(temp::LabelFactory::NamedLabel("alloc_record")),
+              record_size_const)));
+
+  tree::Stm *fast_path = new tree::SeqStm(
+      new tree::MoveStm(new tree::TempExp(record_add_reg),
+                        new tree::BinopExp(tree::BinOp::PLUS_OP,
+                                           new tree::TempExp(object_reg),
+                                           new tree::ConstExp(
+                                               gc::INLINE_HEADER_SIZE))),
+      new tree::JumpStm(new tree::NameExp(meet_point),
+                        new std::vector<temp::Label *>({meet_point})));
+  for (int offset = record_size; offset > 0; offset -= reg_manager->WordSize())
+    fast_path = new tree::SeqStm(
+        new tree::MoveStm(
+            new tree::MemExp(new tree::BinopExp(
+                tree::BinOp::PLUS_OP, new tree::TempExp(object_reg),
+                new tree::ConstExp(offset))),
+            new tree::ConstExp(0)),
+        fast_path);
+  fast_path = new tree::SeqStm(
+      new tree::LabelStm(fast_label),
+      new tree::SeqStm(
+          new tree::MoveStm(
+              new tree::MemExp(new tree::NameExp(alloc_ptr)),
+              new tree::TempExp(end_reg)),
+          new tree::SeqStm(
+              new tree::MoveStm(
+                  new tree::MemExp(new tree::TempExp(object_reg)),
+                  new tree::NameExp(temp::LabelFactory::NamedLabel(
+                      std::string(typ_->Name()) +
+                      gc::HEADER_DESCRIPTOR_SUFFIX))),
+              fast_path)));
+
+  tree::Stm *alloca_record = new tree::SeqStm(
+      new tree::MoveStm(new tree::TempExp(object_reg),
+                        new tree::MemExp(new tree::NameExp(alloc_ptr))),
+      new tree::SeqStm(
+          new tree::MoveStm(
+              new tree::TempExp(end_reg),
+              new tree::BinopExp(
+                  tree::BinOp::PLUS_OP, new tree::TempExp(object_reg),
+                  new tree::ConstExp(record_size + gc::INLINE_HEADER_SIZE))),
+          new tree::SeqStm(
+              new tree::CjumpStm(
+                  tree::RelOp::GT_OP, new tree::TempExp(end_reg),
+                  new tree::MemExp(new tree::NameExp(alloc_limit)), slow_label,
+                  fast_label),
+              new tree::SeqStm(
+                  fast_path,
+                  new tree::SeqStm(slow_path,
+                                   new tree::LabelStm(meet_point))))));
 
   /* Initialize Fields */
   std::list<tree::Exp *> exps_ = field_exp_->GetList();
-  for (auto exps_iter = exps_.begin(); exps_iter != exps_.end(); exps_iter++)
+  for (auto exps_iter = exps_.begin(); exps_iter != exps_.end(); exps_iter++) {
+    int index = std::distance(exps_.begin(), exps_iter);
     alloca_record = new tree::SeqStm(
         alloca_record,
         new tree::MoveStm(
             new tree::MemExp(new tree::BinopExp(
                 tree::BinOp::PLUS_OP, new tree::TempExp(record_add_reg),
-                new tree::ConstExp(reg_manager->WordSize() *
-                                   std::distance(exps_.begin(), exps_iter)))),
-            *exps_iter));
+                new tree::ConstExp(reg_manager->WordSize() * index))),
+            *exps_iter, field_pointer[index]));
+  }
 
   tr::Exp *exp_rt = new tr::ExExp(
       new tree::EseqExp(alloca_record, new tree::TempExp(record_add_reg)));
@@ -480,8 +560,12 @@ tr::ExpAndTy *AssignExp::Translate(env::VEnvPtr venv, env::TEnvPtr tenv,
   tr::ExpAndTy *right_exp_trans =
       exp_->Translate(venv, tenv, level, label, errormsg);
 
+  // For GC, 帧中的变量是根, 只有heap对象中的指针字段和元素需要写屏障
+  bool barrier = (typeid(*var_) == typeid(FieldVar) ||
+                  typeid(*var_) == typeid(SubscriptVar)) &&
+                 IsPointer(var_trans->ty_);
   tr::Exp *exp_return = new tr::NxExp(new tree::MoveStm(
-      var_trans->exp_->UnEx(), right_exp_trans->exp_->UnEx()));
+      var_trans->exp_->UnEx(), right_exp_trans->exp_->UnEx(), barrier));
 
   return new tr::ExpAndTy(exp_return, type::VoidTy::Instance());
 }
@@ -695,6 +779,9 @@ tr::ExpAndTy *ArrayExp::Translate(env::VEnvPtr venv, env::TEnvPtr tenv,
   tree::ExpList *exp_list = new tree::ExpList();
   exp_list->Append(size_tran->exp_->UnEx());
   exp_list->Append(init_tran->exp_->UnEx());
+  // For GC: 元素为指针的数组需要扫描
+  bool has_pointers = IsPointer(static_cast<type::ArrayTy *>(typ_ptr)->ty_);
+  exp_list->Append(new tree::ConstExp(has_pointers ? 1 : 0));
   tr::Exp *exp_ = new tr::ExExp(new tree::CallExp(
       new tree::NameExp(temp::LabelFactory::NamedLabel("init_array")),
       exp_list));
@@ -767,7 +854,7 @@ tr::Exp *FunctionDec::Translate(env::VEnvPtr venv, env::TEnvPtr tenv,
     tenv->EndScope();
     // For GC
     if (IsPointer(func_entry->result_))
-      functions_ret_ptr.push_back(func_entry->label_->Name());
+      functions_ret_ptr.emplace_back(func_entry->label_->Name());
 
     tree::Stm *movToRetReg = new tree::MoveStm(
         new tree::TempExp(reg_manager->ReturnValue()), body_tran->exp_->UnEx());
@@ -199,6 +199,36 @@ RelOp NotRel(RelOp r) {
   }
 }
 
+int NodeCount(Stm *stm) {
+  if (auto seq = dynamic_cast<SeqStm *>(stm))
+    return 1 + NodeCount(seq->left_) + NodeCount(seq->right_);
+  if (auto jump = dynamic_cast<JumpStm *>(stm))
+    return 1 + NodeCount(jump->exp_);
+  if (auto cjump = dynamic_cast<CjumpStm *>(stm))
+    return 1 + NodeCount(cjump->left_) + NodeCount(cjump->right_);
+  if (auto move = dynamic_cast<MoveStm *>(stm))
+    return 1 + NodeCount(move->dst_) + NodeCount(move->src_);
+  if (auto exp = dynamic_cast<ExpStm *>(stm))
+    return 1 + NodeCount(exp->exp_);
+  return 1;
+}
+
+int NodeCount(Exp *exp) {
+  if (auto binop = dynamic_cast<BinopExp *>(exp))
+    return 1 + NodeCount(binop->left_) + NodeCount(binop->right_);
+  if (auto mem = dynamic_cast<MemExp *>(exp))
+    return 1 + NodeCount(mem->exp_);
+  if (auto eseq = dynamic_cast<EseqExp *>(exp))
+    return 1 + NodeCount(eseq->stm_) + NodeCount(eseq->exp_);
+  if (auto call = dynamic_cast<CallExp *>(exp)) {
+    int count = 1 + NodeCount(call->fun_);
+    for (Exp *arg : call->args_->GetList())
+      count += NodeCount(arg);
+    return count;
+  }
+  return 1;
+}
+
 RelOp Commute(RelOp r) {
   switch (r) {
   case EQ_OP:
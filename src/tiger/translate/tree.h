@@ -8,6 +8,7 @@
 #include <string>
 
 #include "tiger/frame/temp.h"
+#include "tiger/util/arena.h"
 
 // Forward Declarations
 namespace canon {
@@ -64,7 +65,7 @@ enum RelOp {
  * Statements
  */
 
-class Stm {
+class Stm : public arena::ArenaObject<Stm> {
  public:
   virtual ~Stm() = default;
 
@@ -138,8 +139,11 @@ class CjumpStm : public Stm {
 class MoveStm : public Stm {
  public:
   Exp *dst_, *src_;
+  /* dst_是heap对象中类型为指针的字段或数组元素, 写入后需要写屏障 */
+  bool barrier_;
 
-  MoveStm(Exp *dst, Exp *src) : dst_(dst), src_(src) {}
+  MoveStm(Exp *dst, Exp *src, bool barrier = false)
+      : dst_(dst), src_(src), barrier_(barrier) {}
   ~MoveStm() override;
 
   void Print(FILE *out, int d) const override;
@@ -163,7 +167,7 @@ class ExpStm : public Stm {
  *Expressions
  */
 
-class Exp {
+class Exp : public arena::ArenaObject<Exp> {
  public:
   virtual ~Exp() = default;
 
@@ -261,7 +265,7 @@ class CallExp : public Exp {
   temp::Temp *Munch(assem::InstrList &instr_list, std::string_view fs) override;
 };
 
-class ExpList {
+class ExpList : public arena::ArenaObject<ExpList, true> {
  public:
   ExpList() = default;
   ExpList(std::initializer_list<Exp *> list) : exp_list_(list) {}
@@ -276,7 +280,7 @@ class ExpList {
   std::list<Exp *> exp_list_;
 };
 
-class StmList {
+class StmList : public arena::ArenaObject<StmList, true> {
   friend class canon::Canon;
 
  public:
@@ -293,6 +297,9 @@ class StmList {
 RelOp NotRel(RelOp);   // a op b == not(a NotRel(op) b)
 RelOp Commute(RelOp);  // a op b == b Commute(op) a
 
+int NodeCount(Stm *stm);  // Number of Stm and Exp nodes in the tree
+int NodeCount(Exp *exp);
+
 }  // namespace tree
 
 #endif  // TIGER_TRANSLATE_TREE_H_
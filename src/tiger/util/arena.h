@@ -0,0 +1,170 @@
+#ifndef TIGER_UTIL_ARENA_H_
+#define TIGER_UTIL_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace arena {
+
+/**
+ * Bump-pointer region. Objects are carved out of large chunks and are all
+ * released together when the arena dies; `delete` on an arena object only
+ * runs its destructor. Objects that own heap memory of their own (std::list,
+ * std::string members) register a finalizer, run on Release() unless the
+ * object was already deleted explicitly.
+ */
+class Arena {
+public:
+  static constexpr size_t kChunkSize = 64 * 1024;
+  static constexpr size_t kAlign = alignof(std::max_align_t);
+
+  struct Header {
+    Header *next;
+    void (*finalize)(void *);
+  };
+
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  ~Arena() { Release(); }
+
+  // `align` must be a power of two no larger than kAlign
+  void *Allocate(size_t size, size_t align = kAlign) {
+    size_t pad = -reinterpret_cast<uintptr_t>(cur_) & (align - 1);
+    if (pad + size > (size_t)(end_ - cur_)) {
+      NewChunk(size);
+      pad = 0;
+    }
+    void *p = cur_ + pad;
+    cur_ += pad + size;
+    allocated_ += size;
+    return p;
+  }
+
+  // Run `header->finalize` on Release()
+  void AddFinalizer(Header *header) {
+    header->next = finalizers_;
+    finalizers_ = header;
+  }
+
+  // Finalize the live objects and free every chunk
+  void Release();
+
+  [[nodiscard]] size_t BytesAllocated() const { return allocated_; }
+  [[nodiscard]] size_t BytesReserved() const { return reserved_; }
+
+private:
+  void NewChunk(size_t size);
+
+  std::vector<char *> chunks_;
+  char *cur_ = nullptr;
+  char *end_ = nullptr;
+  Header *finalizers_ = nullptr;
+  size_t allocated_ = 0;
+  size_t reserved_ = 0;
+};
+
+inline void Arena::NewChunk(size_t size) {
+  size_t chunk = size > kChunkSize ? size : kChunkSize;
+  char *p = static_cast<char *>(::operator new(chunk));
+  chunks_.push_back(p);
+  cur_ = p;
+  end_ = p + chunk;
+  reserved_ += chunk;
+}
+
+inline void Arena::Release() {
+  // 后分配的先析构
+  for (Header *h = finalizers_; h; h = h->next)
+    if (h->finalize)
+      h->finalize(h + 1);
+  finalizers_ = nullptr;
+  for (char *p : chunks_)
+    ::operator delete(p);
+  chunks_.clear();
+  cur_ = end_ = nullptr;
+  allocated_ = reserved_ = 0;
+}
+
+namespace detail {
+inline thread_local Arena *current = nullptr;
+} // namespace detail
+
+// Arena that ArenaObjects are allocated from on this thread, nullptr for heap
+inline Arena *Current() { return detail::current; }
+
+// Arena of the whole compilation: AST, symbols and the IR of translate.
+// Never released, the memory goes back to the OS on exit.
+inline Arena *Program() {
+  static Arena *program = new Arena();
+  return program;
+}
+
+// Make `arena` the current arena until the end of the scope
+class Scope {
+public:
+  explicit Scope(Arena *arena) : saved_(detail::current) {
+    detail::current = arena;
+  }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+  ~Scope() { detail::current = saved_; }
+
+private:
+  Arena *saved_;
+};
+
+/**
+ * Base for classes allocated with plain `new` from the current arena, falling
+ * back to the heap if there is none. Only leaf objects whose destructor does
+ * not delete other arena objects may set kFinalize; owners of arena objects
+ * are never finalized, so no destructor runs twice.
+ */
+template <typename T, bool kFinalize = false> class ArenaObject {
+public:
+  static void *operator new(size_t size) {
+    using Header = Arena::Header;
+    Arena *arena = Current();
+    Header *h;
+    if (arena) {
+      h = static_cast<Header *>(arena->Allocate(sizeof(Header) + size));
+      h->next = nullptr;
+      h->finalize = nullptr;
+      if (kFinalize) {
+        h->finalize = Finalize;
+        arena->AddFinalizer(h);
+      }
+    } else {
+      h = static_cast<Header *>(::operator new(sizeof(Header) + size));
+      h->next = HeapTag();
+      h->finalize = nullptr;
+    }
+    return h + 1;
+  }
+
+  static void operator delete(void *p) {
+    if (!p)
+      return;
+    using Header = Arena::Header;
+    Header *h = static_cast<Header *>(p) - 1;
+    if (h->next == HeapTag())
+      ::operator delete(h);
+    else
+      h->finalize = nullptr; // destroyed, memory goes with the arena
+  }
+
+private:
+  static Arena::Header *HeapTag() {
+    return reinterpret_cast<Arena::Header *>(uintptr_t(1));
+  }
+  static void Finalize(void *p) { static_cast<T *>(p)->~T(); }
+};
+
+static_assert(sizeof(Arena::Header) % Arena::kAlign == 0,
+              "arena header breaks object alignment");
+
+} // namespace arena
+
+#endif // TIGER_UTIL_ARENA_H_
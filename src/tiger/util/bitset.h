@@ -0,0 +1,99 @@
+#ifndef TIGER_UTIL_BITSET_H_
+#define TIGER_UTIL_BITSET_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace bitset {
+
+/**
+ * Dense fixed-size bit vector, used as the set representation of the
+ * dataflow analyses. Elements are small integers in [0, Size()).
+ */
+class BitSet {
+public:
+  BitSet() : size_(0) {}
+  explicit BitSet(int size) : size_(size), words_((size + 63) / 64, 0) {}
+
+  [[nodiscard]] int Size() const { return size_; }
+
+  void Set(int i) { words_[i >> 6] |= (uint64_t)1 << (i & 63); }
+  void Reset(int i) { words_[i >> 6] &= ~((uint64_t)1 << (i & 63)); }
+  [[nodiscard]] bool Test(int i) const {
+    return (words_[i >> 6] >> (i & 63)) & 1;
+  }
+  void Clear() {
+    for (uint64_t &w : words_)
+      w = 0;
+  }
+
+  // this |= other, return true if this changed
+  bool UnionWith(const BitSet &other);
+
+  // this &= ~other
+  void Subtract(const BitSet &other);
+
+  // this = use | (out & ~def), return true if this changed
+  bool Transfer(const BitSet &use, const BitSet &out, const BitSet &def);
+
+  [[nodiscard]] int Count() const;
+
+  // Call f on every element in ascending order
+  void ForEach(const std::function<void(int)> &f) const;
+
+  bool operator==(const BitSet &other) const { return words_ == other.words_; }
+  bool operator!=(const BitSet &other) const { return words_ != other.words_; }
+
+private:
+  int size_;
+  std::vector<uint64_t> words_;
+};
+
+inline bool BitSet::UnionWith(const BitSet &other) {
+  uint64_t changed = 0;
+  for (size_t i = 0; i < words_.size(); i++) {
+    uint64_t w = words_[i] | other.words_[i];
+    changed |= w ^ words_[i];
+    words_[i] = w;
+  }
+  return changed != 0;
+}
+
+inline void BitSet::Subtract(const BitSet &other) {
+  for (size_t i = 0; i < words_.size(); i++)
+    words_[i] &= ~other.words_[i];
+}
+
+inline bool BitSet::Transfer(const BitSet &use, const BitSet &out,
+                             const BitSet &def) {
+  uint64_t changed = 0;
+  for (size_t i = 0; i < words_.size(); i++) {
+    uint64_t w = use.words_[i] | (out.words_[i] & ~def.words_[i]);
+    changed |= w ^ words_[i];
+    words_[i] = w;
+  }
+  return changed != 0;
+}
+
+inline int BitSet::Count() const {
+  int count = 0;
+  for (uint64_t w : words_)
+    count += __builtin_popcountll(w);
+  return count;
+}
+
+inline void BitSet::ForEach(const std::function<void(int)> &f) const {
+  for (size_t i = 0; i < words_.size(); i++) {
+    uint64_t w = words_[i];
+    while (w) {
+      int bit = __builtin_ctzll(w);
+      f((int)(i * 64 + bit));
+      w &= w - 1;
+    }
+  }
+}
+
+} // namespace bitset
+
+#endif // TIGER_UTIL_BITSET_H_
@@ -1,6 +1,7 @@
 #ifndef TIGER_UTIL_GRAPH_H_
 #define TIGER_UTIL_GRAPH_H_
 
+#include "tiger/util/arena.h"
 #include "tiger/util/table.h"
 
 namespace graph {
@@ -36,7 +37,7 @@ private:
   NodeList<T> *my_nodes_;
 };
 
-template <typename T> class Node {
+template <typename T> class Node : public arena::ArenaObject<Node<T>> {
   template <typename NodeType> friend class Graph;
 
 public:
@@ -87,7 +88,8 @@ private:
         info_(nullptr) {}
 };
 
-template <typename T> class NodeList {
+template <typename T>
+class NodeList : public arena::ArenaObject<NodeList<T>, true> {
   friend class Graph<T>;
   friend class Node<T>;
 
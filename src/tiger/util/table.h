@@ -2,12 +2,21 @@
 #define TIGER_UTIL_TABLE_H_
 
 #include <cassert>
+#include <cstdint>
 #include <functional>
+#include <vector>
 
 namespace tab {
+
+/**
+ * Scoped hash table keyed by pointer. Bindings live on a stack in the order
+ * they were entered, so Pop removes the newest one and uncovers the binding
+ * it shadowed. The index is an open-addressing (linear probing) table from
+ * key to its newest binding, doubled when half full.
+ */
 template <typename KeyType, typename ValueType> class Table {
 public:
-  Table() : top_(nullptr), table_() {}
+  Table() : slots_(kInitSize) {}
   void Enter(KeyType *key, ValueType *value);
   ValueType *Look(KeyType *key);
   void Set(KeyType *key, ValueType *value);
@@ -15,79 +24,119 @@ public:
   void Dump(std::function<void(KeyType *, ValueType *)> show);
 
 protected:
-  static const unsigned long TABSIZE = 127;
+  static const size_t kInitSize = 16;
+  static const int kNone = -1;
+
   struct Binder {
-  public:
     KeyType *key;
     ValueType *value;
-    Binder *next;
-    KeyType *prevtop;
+    int shadowed; // Older binding of the same key, kNone if there is none
+  };
 
-    Binder(KeyType *key, ValueType *value, Binder *next, KeyType *prevtop)
-        : key(key), value(value), next(next), prevtop(prevtop) {}
+  struct Slot {
+    KeyType *key = nullptr;
+    int binder = kNone; // Newest binding of key
   };
 
-  Binder *table_[TABSIZE];
-  KeyType *top_;
+  size_t Hash(KeyType *key) const {
+    // 指针低位是对齐的0, 乘法散列后取高位
+    uint64_t h = reinterpret_cast<uintptr_t>(key) * 0x9E3779B97F4A7C15ull;
+    return (h >> 32) & (slots_.size() - 1);
+  }
+  // Slot holding key, or the empty slot where it would go
+  size_t Find(KeyType *key) const;
+  void Grow();
+  void Erase(size_t index);
+
+  std::vector<Slot> slots_;
+  std::vector<Binder> binders_;
+  size_t used_ = 0;
 };
 
+template <typename KeyType, typename ValueType>
+size_t Table<KeyType, ValueType>::Find(KeyType *key) const {
+  size_t mask = slots_.size() - 1;
+  size_t i = Hash(key);
+  while (slots_[i].key && slots_[i].key != key)
+    i = (i + 1) & mask;
+  return i;
+}
+
+template <typename KeyType, typename ValueType>
+void Table<KeyType, ValueType>::Grow() {
+  std::vector<Slot> old(slots_.size() * 2);
+  old.swap(slots_);
+  for (const Slot &slot : old)
+    if (slot.key)
+      slots_[Find(slot.key)] = slot;
+}
+
+/* 线性探测的删除: 把后面探测链上的项前移, 不留墓碑 */
+template <typename KeyType, typename ValueType>
+void Table<KeyType, ValueType>::Erase(size_t index) {
+  size_t mask = slots_.size() - 1;
+  size_t hole = index;
+  for (size_t i = (index + 1) & mask; slots_[i].key; i = (i + 1) & mask) {
+    size_t home = Hash(slots_[i].key);
+    // 若home不在(hole, i]之间, 该项可以移到hole
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      slots_[hole] = slots_[i];
+      hole = i;
+    }
+  }
+  slots_[hole] = Slot();
+  used_--;
+}
+
 template <typename KeyType, typename ValueType>
 void Table<KeyType, ValueType>::Enter(KeyType *key, ValueType *value) {
-  unsigned long index = reinterpret_cast<unsigned long>(key) % TABSIZE;
-  table_[index] = new Binder(key, value, table_[index], top_);
-  top_ = key;
+  assert(key);
+  if ((used_ + 1) * 2 > slots_.size())
+    Grow();
+  Slot &slot = slots_[Find(key)];
+  if (!slot.key) {
+    slot.key = key;
+    used_++;
+  }
+  binders_.push_back({key, value, slot.binder});
+  slot.binder = static_cast<int>(binders_.size()) - 1;
 }
 
 template <typename KeyType, typename ValueType>
 ValueType *Table<KeyType, ValueType>::Look(KeyType *key) {
   assert(key);
-  unsigned long index = reinterpret_cast<unsigned long>(key) % TABSIZE;
-  Binder *b;
-  for (b = table_[index]; b; b = b->next)
-    if (b->key == key)
-      return b->value;
-  return nullptr;
+  const Slot &slot = slots_[Find(key)];
+  return slot.key ? binders_[slot.binder].value : nullptr;
 }
 
 template <typename KeyType, typename ValueType>
 void Table<KeyType, ValueType>::Set(KeyType *key, ValueType *value) {
   assert(key);
-  unsigned long index = reinterpret_cast<unsigned long>(key) % TABSIZE;
-  Binder *b;
-  for (b = table_[index]; b; b = b->next)
-    if (b->key == key) {
-      b->value = value;
-      return;
-    }
+  const Slot &slot = slots_[Find(key)];
+  if (slot.key)
+    binders_[slot.binder].value = value;
 }
 
 template <typename KeyType, typename ValueType>
 KeyType *Table<KeyType, ValueType>::Pop() {
-  KeyType *k = top_;
-  assert(k);
-  unsigned long index = reinterpret_cast<unsigned long>(k) % TABSIZE;
-  Binder *b = table_[index];
-  assert(b);
-  table_[index] = b->next;
-  top_ = b->prevtop;
-  return b->key;
+  assert(!binders_.empty());
+  Binder b = binders_.back();
+  binders_.pop_back();
+  size_t index = Find(b.key);
+  assert(slots_[index].key == b.key);
+  if (b.shadowed == kNone)
+    Erase(index);
+  else
+    slots_[index].binder = b.shadowed;
+  return b.key;
 }
 
+/* 从新到旧输出全部绑定, 包括被遮蔽的 */
 template <typename KeyType, typename ValueType>
 void Table<KeyType, ValueType>::Dump(
     std::function<void(KeyType *, ValueType *)> show) {
-  KeyType *k = top_;
-  unsigned long index = reinterpret_cast<unsigned long>(k) % TABSIZE;
-  Binder *b = table_[index];
-  if (b == nullptr)
-    return;
-  table_[index] = b->next;
-  top_ = b->prevtop;
-  show(b->key, b->value);
-  Dump(show);
-  assert(top_ == b->prevtop && table_[index] == b->next);
-  top_ = k;
-  table_[index] = b;
+  for (auto it = binders_.rbegin(); it != binders_.rend(); ++it)
+    show(it->key, it->value);
 }
 
 } // namespace tab